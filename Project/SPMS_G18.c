@@ -5,75 +5,582 @@
    and independent simulation of OPTI scheduling,
    including dynamic calculation of resource utilization in the summary report.
    Written in C (C90 compliant).
+   Build: gcc -O2 -pthread SPMS_G18.c -o SPMS
+   Server mode: ./SPMS -server PATH serves kiosk clients on a Unix-domain
+   socket (see spms_client.c and spms_load.c).
+   Persistence: ./SPMS -data DIR journals every booking to DIR and restores
+   them on the next start.
+   Report transport: ./SPMS -report shm passes report text to the printer
+   process through a shared-memory ring instead of its socket.
+   In server mode printBookings runs in a forked child, so other clients'
+   bookings are admitted while a long report is computed and printed.
+   PRIO regression check (preemption rollback):
+     printf 'addBatch -prio_rollback.dat\nprintBookings -prio\nendProgram\n' |
+         ./SPMS | diff - prio_rollback.expected
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>        /* for clock_gettime() in the OPTI_EXACT time budget */
 #include <unistd.h>      /* for fork(), pipe(), read(), write() */
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>    /* for mmap() of batch files */
+#include <pthread.h>     /* for the date-sharded batch ingestion */
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>  /* for the Unix-domain socket server mode */
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h> /* for the shared-memory report ring */
+#include <poll.h>
+#include <stdint.h>
 
-#define MAX_BOOKINGS 200
 #define MAX_LINE_LENGTH 256
+#define MAX_FIELDS 16
+#define MAX_NAME_LENGTH 32                /* member and device names */
 #define PARKING_CAPACITY 10
 #define ESSENTIAL_CAPACITY 3
+#define HOURS_PER_DAY 24
+#define SLOT_MINUTES 15                   /* occupancy is tracked per 15-minute slot */
+#define SLOTS_PER_DAY (HOURS_PER_DAY * 60 / SLOT_MINUTES)
+#define SLOT_WORDS ((SLOTS_PER_DAY + 63) / 64)
+#define OPTI_FIRST_SLOT (8 * 60 / SLOT_MINUTES)   /* OPTI may move bookings to 08:00-20:00 */
+#define OPTI_LAST_SLOT (20 * 60 / SLOT_MINUTES)
+#define MAX_OPTI_DAYS 31                  /* widest day radius accepted by setOPTI */
+#define MAX_OPTI_WORKERS 16
+#define OPTI_PARALLEL_MIN 2048            /* fewer rejected bookings are placed in-process */
+#define MAX_SHARDS 16
+#define SHARD_QUEUE_SIZE 4096
+#define EXACT_REJECT (-2)                 /* OPTI_EXACT choice: booking not accepted */
+#define EXACT_ORIGINAL (-1)               /* OPTI_EXACT choice: requested time */
+#define EXACT_MS_PER_REJECTED 1           /* OPTI_EXACT budget per booking FCFS rejected */
+#define MAX_DEVICES 32                    /* device ids must fit in the essentials bitmask */
+#define NO_DEVICE 0xFF
+#define NAME_HASH_MIN 64
+#define EPOCH_YEAR 2000                   /* dates are stored as days since 2000-01-01 */
+#define MAX_YEARS 100
+#define MAX_DAYS (MAX_YEARS * 366)
+#define CHUNK_SHIFT 12
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)     /* bookings per store chunk */
+#define MAX_CHUNKS 65536                  /* up to 268M bookings */
+#define ARENA_BLOCK_SIZE ((size_t)4 << 20)
+#define SERVER_EVENTS 64                  /* epoll events handled per wakeup */
+#define SERVER_SEND_TIMEOUT 5             /* seconds before a stalled client is dropped */
+#define MAX_REPORT_WORKERS 16             /* server-mode reports running in forked children */
+#define MAX_PATH_LENGTH 4096
+#define REPORT_FRAME_SIZE ((size_t)4 << 20)  /* report text handed to the reporter at a time */
+#define REPORT_CHUNK ((size_t)1 << 20)       /* bytes per write() in the reporter */
+#define REPORT_RING_SIZE ((size_t)4 << 20)   /* shared-memory ring of -report shm */
+#define LATENCY_BUCKETS 32                /* power-of-two microsecond buckets, up to ~71 minutes */
+#define JOURNAL_BUFFER_SIZE (1 << 16)
+#define JOURNAL_CHECKPOINT_BOOKINGS (1 << 20)  /* journaled bookings that trigger a checkpoint */
+#define CHECKPOINT_MAGIC "SPMSCKP1"
 
-/* Structure to hold a booking request */
+/* Booking types, numbered by priority: Event = 3, Reservation = 2, Parking = 1, Essentials = 0 */
+enum { TYPE_ESSENTIALS, TYPE_PARKING, TYPE_RESERVATION, TYPE_EVENT };
+const char *typeNames[] = { "Essentials", "Parking", "Reservation", "Event" };
+
+/* Structure to hold a booking request (names are interned, see NameTable) */
 typedef struct {
-    char type[20];        /* "Parking", "Reservation", "Event", "Essentials" */
-    char member[20];      /* e.g. "member_A" */
-    char date[11];        /* YYYY-MM-DD */
-    char time[6];         /* hh:mm */
-    float duration;       /* Duration in hours */
-    char essential1[20];  /* For addParking/addReservation: first extra device */
-    char essential2[20];  /* For addParking/addReservation: second extra device */
-    char essential3[20];  /* For addEvent: third essential device */
-    int requires_parking; /* 1 if a parking slot is required, 0 otherwise */
-    int accepted;         /* 1 = accepted, 0 = rejected */
+    int member;                     /* member id, e.g. "member_A" */
+    int date;                       /* day number, see parse_date */
+    float duration;                 /* Duration in hours */
+    unsigned int essentials;        /* bitmask of requested device ids */
+    short start;                    /* start time in minutes after midnight */
+    unsigned char type;             /* TYPE_* */
+    unsigned char device[3];        /* device ids in request order, NO_DEVICE = unused */
+    unsigned char requires_parking; /* 1 if a parking slot is required, 0 otherwise */
+    unsigned char accepted;         /* 1 = accepted, 0 = rejected */
 } Booking;
 
-/* Global array for FCFS (原始預約記錄) */
-Booking bookings[MAX_BOOKINGS];
-int bookingCount = 0;
+/* A field of a command line: points into the caller's buffer, not terminated */
+typedef struct {
+    const char *text;
+    int len;
+} Field;
+
+/* Name table: interns short strings (members, dates, device names) into dense integer ids */
+typedef struct {
+    char **names;         /* id -> name */
+    int count;
+    int capacity;
+    int limit;            /* maximum number of ids, 0 = unlimited */
+    int *slots;           /* open-addressing hash table storing id + 1, 0 = empty */
+    int slotCount;        /* power of two */
+} NameTable;
+
+/* A set of slots of one day, one bit per slot */
+typedef struct {
+    unsigned long long w[SLOT_WORDS];
+} SlotSet;
+
+/* Occupancy of one date, updated whenever a booking is accepted. Each resource keeps
+   one SlotSet per unit of capacity: bit s of level[k] is set when more than k units
+   are in use during slot s, so a resource is full over a range exactly when the range
+   meets its top level */
+typedef struct {
+    SlotSet parking[PARKING_CAPACITY];
+    SlotSet device[MAX_DEVICES][ESSENTIAL_CAPACITY];
+} DayOccupancy;
+
+/* Bookings parsed by a bulk addBatch, admitted together before being stored */
+typedef struct {
+    Booking *items;
+    int count;
+    int capacity;
+    int total;            /* bookings read in the whole batch */
+    int accepted;
+} BulkBatch;
+
+struct ShardPool;
+
+/* One owner thread of the sharded batch ingestion: it alone admits the bookings
+   of the dates mapped to it, taking them from its FIFO in arrival order */
+typedef struct {
+    struct ShardPool *pool;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    pthread_cond_t drained;
+    int items[SHARD_QUEUE_SIZE];    /* indexes into pool->pending */
+    int head;
+    int count;
+    int busy;                       /* an item is being admitted */
+    int closing;
+} Shard;
+
+/* Date-sharded FCFS ingestion: the parsing thread routes each booking to the
+   shard owning its date (date % shardCount); the decisions are appended to
+   the store in arrival order whenever the shards are drained */
+typedef struct ShardPool {
+    Shard shards[MAX_SHARDS];
+    int shardCount;
+    Booking *pending;               /* parsed bookings awaiting the store */
+    int capacity;
+    int count;
+    int total;                      /* bookings read in the whole batch */
+    int accepted;
+} ShardPool;
+
+/* Arena allocator: memory is carved from large blocks and never freed individually */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+/* Column-oriented copy of the booking fields scanned by the summary report,
+   one per store chunk, so the scans only touch the columns they need */
+typedef struct {
+    int date[CHUNK_SIZE];
+    short start[CHUNK_SIZE];
+    float duration[CHUNK_SIZE];
+    unsigned char type[CHUNK_SIZE];
+    unsigned int essentials[CHUNK_SIZE];
+    unsigned char accepted[CHUNK_SIZE];
+} ColumnChunk;
+
+/* Growable booking store made of fixed-size chunks; a chunk never moves once
+   allocated, so Booking pointers stay valid while the store grows */
+typedef struct {
+    Booking *chunks[MAX_CHUNKS];
+    ColumnChunk *columns[MAX_CHUNKS];
+    int chunkCount;
+    int count;
+    unsigned long generation;       /* bumped on every change to the booking set */
+} BookingStore;
+
+/* Result of a scheduling simulation, overlaid on the shared booking store
+   instead of copying every Booking */
+typedef struct {
+    int count;
+    unsigned char *accepted;  /* per booking: 1 = accepted under this schedule */
+    short *startSlot;         /* per booking: rescheduled start slot, -1 = original time */
+    short *dayShift;          /* per booking: days moved from the requested date */
+    int search;               /* OPTI_EXACT only: 1 = proven optimal over its candidate
+                                 start times, 2 = stopped by budget */
+    int preempted;            /* PRIO only: accepted bookings evicted by higher priorities */
+} Schedule;
+
+/* Branch-and-bound state of OPTI_EXACT for the bookings of one date */
+typedef struct {
+    int *idx;                 /* bookings of the date in arrival order */
+    int n;
+    short *choice;            /* current branch: start slot or EXACT_* */
+    short *best;              /* best assignment found so far */
+    int bestCount;
+    DayOccupancy occ;         /* occupancy of the current branch */
+    long nodes;               /* work done: nodes plus bookings examined by the bound */
+    double deadline;          /* CLOCK_MONOTONIC milliseconds */
+    int timedOut;
+} ExactSearch;
+
+/* Accepted holders of one resource at one priority level; entries whose booking
+   has since been evicted are skipped, and compacted away once the admission that
+   scanned them has committed or rolled back its evictions */
+typedef struct {
+    int *items;
+    int count;
+    int capacity;
+} HolderList;
+
+#define PRIO_LEVELS 4                     /* one per TYPE_* */
+#define PRIO_RESOURCES (1 + MAX_DEVICES)  /* 0 = parking, 1 + d = device d */
+
+/* State of one date during a PRIO run: slot occupancy plus, per resource,
+   the holders bucketed by priority. Choosing a victim still scans every
+   lower-priority bucket of each needed resource on that date (linear in those
+   holders), since the victim is the one covering the most deficit slots */
+typedef struct {
+    DayOccupancy occ;
+    HolderList holders[PRIO_RESOURCES][PRIO_LEVELS];
+} PrioDay;
+
+/* Per-day occupancy of one OPTI run over dates [lo, hi], rebuilt from the
+   schedule's own accepted bookings so it matches the snapshot being reported */
+typedef struct {
+    int lo;
+    int hi;
+    DayOccupancy **days;
+} OptiWork;
+
+/* Aggregated statistics of one scheduling result (FCFS, PRIO or OPTI) */
+typedef struct {
+    int accepted;
+    int rejected;
+    int earliest;                   /* earliest / latest accepted day number */
+    int latest;
+    double parkingHours;
+    double deviceHours[MAX_DEVICES];
+    int moved;                      /* accepted after being rescheduled */
+    int movedDays;                  /* ... of which to another date */
+    double shiftHours;              /* total distance moved */
+    int search;                     /* copied from Schedule.search */
+    int preempted;                  /* copied from Schedule.preempted */
+} ScheduleStats;
+
+/* Watermark of the booking store taken by a report: the schedule, its cache entry
+   and any schedule worker all cover bookings [0, count) of one generation, with
+   the FCFS statistics of exactly those bookings. In server mode a report runs in
+   a forked child (see report_start), whose copy-on-write memory is the actual
+   point-in-time view, name tables included; the generation tells the parent
+   whether the schedules the child sends back still match its bookings */
+typedef struct {
+    int count;
+    unsigned long generation;
+    ScheduleStats fcfs;             /* FCFS statistics of exactly those bookings */
+} Snapshot;
+
+/* Memoized result of one scheduling algorithm, valid while its generation
+   equals the generation of the snapshot being reported */
+typedef struct {
+    int valid;
+    unsigned long generation;
+    unsigned long epoch;            /* bumped by cache_clear: older results are stale */
+    Schedule sched;
+    ScheduleStats stats;
+} ScheduleCache;
+
+/* A forked process running one scheduling algorithm */
+typedef struct {
+    pid_t pid;
+    int fd;                         /* read end of the result pipe */
+    int stat;                       /* latency histogram of the algorithm, STAT_* */
+    double start;
+} ScheduleWorker;
+
+/* Latency histograms kept by printStats: one per command type, one per
+   scheduling algorithm and one for the output of the reports */
+enum {
+    STAT_ADD_PARKING, STAT_ADD_RESERVATION, STAT_ADD_EVENT, STAT_BOOK_ESSENTIALS,
+    STAT_ADD_BATCH, STAT_SET_OPTI, STAT_PRINT_BOOKINGS, STAT_PRINT_OPTI, STAT_PRINT_OPTI_EXACT,
+    STAT_PRINT_SUMMARY, STAT_PRINT_STATS,
+    STAT_PRIO, STAT_OPTI, STAT_OPTI_EXACT, STAT_REPORT_OUTPUT,
+    STAT_COUNT
+};
+
+/* Bucket k counts latencies in [2^k, 2^(k+1)) microseconds; bucket 0 also
+   holds everything under one microsecond */
+typedef struct {
+    const char *name;
+    long count;
+    double totalUs;
+    double maxUs;
+    long buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+/* Text of a report being assembled, handed to the reporter process in frames
+   of up to REPORT_FRAME_SIZE bytes */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} ReportBuffer;
+
+/* Header of one frame sent to the reporter, followed by len bytes of text. The
+   message carrying it also passes the descriptor the text goes to, so reports
+   reach the current standard output even when server mode has redirected it */
+typedef struct {
+    size_t len;
+} ReportFrame;
+
+/* Shared-memory ring carrying report text to the reporter (./SPMS -report shm).
+   head and tail only grow: the main process alone advances head, the reporter
+   alone advances tail, and each side wakes the other through an eventfd */
+typedef struct {
+    size_t head;
+    char pad[64 - sizeof(size_t)];  /* keep the two counters on separate cache lines */
+    size_t tail;
+    char data[REPORT_RING_SIZE];
+} ReportRing;
+
+/* Journal record kinds */
+enum { JOURNAL_BOOKING = 1, JOURNAL_MEMBER, JOURNAL_DEVICE };
+
+/* Header of one journal record, followed by len payload bytes: the Booking with
+   its FCFS decision, or a member / device name. index is the booking's store
+   position or the name's id, so records already covered by the checkpoint are
+   recognised and skipped on restart */
+typedef struct {
+    unsigned short kind;
+    unsigned short len;
+    int index;
+    unsigned int check;             /* FNV-1a of the payload, detects a torn tail */
+} JournalRecord;
+
+/* Header of a checkpoint file: the member and device names follow (NUL-terminated,
+   in id order), then count Bookings starting at bookingOffset */
+typedef struct {
+    char magic[8];
+    int bookingSize;                /* sizeof(Booking) of the writer */
+    int count;
+    int memberCount;
+    int deviceCount;
+    long bookingOffset;
+} CheckpointHeader;
+
+/* Append-only journal of the booking store (./SPMS -data DIR). Records are
+   buffered and written at the end of every command; once enough bookings are
+   journaled the store is written to a compact checkpoint and the journal restarts */
+typedef struct {
+    int fd;                         /* -1 = not journaling */
+    int memberCount;                /* names already in the journal or checkpoint */
+    int deviceCount;
+    int bookings;                   /* booking records since the last checkpoint */
+    int used;
+    char journalPath[MAX_PATH_LENGTH];
+    char checkpointPath[MAX_PATH_LENGTH];
+    char buffer[JOURNAL_BUFFER_SIZE];
+} Journal;
+
+/* One connection in server mode. Requests are command lines ending in '\n';
+   each response is the command's usual output followed by one '\0' byte */
+typedef struct {
+    int fd;
+    int len;                        /* bytes buffered in line */
+    int watched;                    /* descriptor registered with epoll, -1 = none */
+    pid_t reportPid;                /* report running in a forked child, 0 = none */
+    int reportFd;                   /* read end of that child's result pipe */
+    char line[MAX_LINE_LENGTH];
+} Client;
+
+/* Header of one schedule a server-mode report child sends back to the parent,
+   followed by its accepted, startSlot and dayShift arrays. cache = -1 ends the
+   list and is followed by the latency histograms the child recorded */
+typedef struct {
+    int cache;                      /* index into reportCaches, -1 = end */
+    int count;
+    unsigned long generation;
+    unsigned long epoch;
+    ScheduleStats stats;
+} ReportResult;
+
+/* Bookings of a schedule grouped for the reports: members in name order, and for the
+   member of rank r its accepted bookings at order[first[r]] .. order[first[r + 1] - 1],
+   its rejected ones at order[first[m + r]] .. order[first[m + r + 1] - 1], m = memberCount */
+typedef struct {
+    int memberCount;
+    const int *members;             /* rank -> member id */
+    int *first;                     /* 2 * memberCount + 1 offsets into order */
+} MemberGroups;
+
+/* Global store for FCFS (原始預約記錄) */
+Arena arena = { NULL };
+BookingStore store;
+
+/* 名稱表：會員、日期及設備名稱在解析時轉為整數 id */
+NameTable memberTable = { NULL, 0, 0, 0, NULL, 0 };
+NameTable deviceTable = { NULL, 0, 0, MAX_DEVICES, NULL, 0 };
+
+/* 依名稱排序的會員 id 及各會員的名次，供報告分組；有新會員時才重新排序 */
+int *memberOrder = NULL, *memberRank = NULL;
+int memberOrderCount = 0;
+
+/* 各模式最近一次的排程結果，預約資料變動前可重複使用 */
+ScheduleCache fcfsCache, prioCache, optiCache, exactCache;
+
+/* 伺服器模式的報告子行程傳回的排程快取（ReportResult.cache 為其索引） */
+#define REPORT_CACHES 3
+ScheduleCache *reportCaches[REPORT_CACHES] = { &prioCache, &optiCache, &exactCache };
+
+/* FCFS 統計：每筆預約收錄時即時更新，摘要報告不需重新掃描 */
+ScheduleStats fcfsStats = { 0, 0, MAX_DAYS, -1 };
+
+/* 最近發佈的快照：收錄端在預約存入後更新 */
+Snapshot published = { 0, 0, { 0, 0, MAX_DAYS, -1 } };
+
+/* OPTI 設定：可移往前後 optiDays 日內，每移動一日的成本相當於同日移動 optiDayCost 小時 */
+int optiDays = 0;
+double optiDayCost = 24.0;
+
+/* OPTI 依日期分工的子行程數目，0 = 每個 CPU 一個 */
+int optiWorkers = 0;
+
+/* OPTI_EXACT 的總時間預算上限（毫秒），實際預算依 FCFS 拒絕的預約數按比例給予，平均分配給各日期 */
+int exactBudgetMs = 250;
+
+/* FCFS 佔用索引：日數 -> 該日各資源的時段佔用，首次有預約時才配置 */
+DayOccupancy *occupancy[MAX_DAYS];
+
+/* 各命令及排程演算法的延遲統計 */
+LatencyHistogram latency[STAT_COUNT] = {
+    { "addParking" }, { "addReservation" }, { "addEvent" }, { "bookEssentials" },
+    { "addBatch" }, { "setOPTI" }, { "printBookings" }, { "printBookings -OPTI" },
+    { "printBookings -OPTI_EXACT" }, { "printBookings -ALL" }, { "printStats" },
+    { "PRIO" }, { "OPTI" }, { "OPTI_EXACT" }, { "report output" }
+};
+
+/* 報告內容緩衝區（重複使用）及常駐 reporter 行程的 socket，-1 表示由本行程直接輸出 */
+ReportBuffer report = { NULL, 0, 0 };
+int reporterSock = -1;
+
+/* -report shm：報告內容經共享記憶體環形緩衝區傳送；ringData 通知 reporter 有新資料，
+   ringSpace 通知主行程已騰出空間。reportRing 為 NULL 時內容隨框架經 socket 傳送 */
+ReportRing *reportRing = NULL;
+int ringData = -1, ringSpace = -1;
+
+/* 多個行程（伺服器模式的報告子行程）共用 reporter 時，逐框架輪流持有此鎖（位於共享記憶體） */
+pthread_mutex_t *reportLock = NULL;
+
+/* 伺服器模式中正在子行程執行的報告數目 */
+int reportWorkers = 0;
+
+/* 預約日誌；未指定 -data 時不寫入 */
+Journal journal = { -1 };
+
+/* 伺服器模式收到 SIGINT / SIGTERM 時設定，事件迴圈隨即結束 */
+volatile sig_atomic_t serverStop = 0;
+
+/* 收到 endProgram 時設定：互動模式結束程式，伺服器模式只結束該連線；
+   批次檔中其後的行不再執行 */
+int endRequested = 0;
 
 /* Function prototypes */
-int get_start_hour(const char *time_str);
-int times_overlap(Booking *b1, Booking *b2);
-int essential_requested(Booking *b, const char *ess);
+int parse_time(const char *text, int len);
+int parse_duration(const char *text, int len, float *hours);
+int parse_date(const char *text, int len);
+const char *format_date(int day, char *buf);
+int essential_requested(const Booking *b, int device);
+unsigned int device_mask(const char *name);
+const char *device_name(const Booking *b, int k);
+void device_list(const Booking *b, int maxDevices, const char *none, char *buf, size_t size);
+int split_fields(const char *line, const char *end, Field *fields, int maxFields);
+int command_type(const Field *f);
+int parse_booking(const Field *fields, int count, int type, Booking *b, const char **error);
+void process_add(char *line, int type);
+int load_batch(const char *path, BulkBatch *bulk, ShardPool *pool);
+int shard_start(ShardPool *pool, int shards);
+void shard_push(ShardPool *pool, const Booking *b);
+void shard_drain(ShardPool *pool);
+void shard_stop(ShardPool *pool);
+int bulk_push(BulkBatch *bulk, const Booking *b);
+int bulk_admit(BulkBatch *bulk);
+int day_fits(const DayOccupancy *day, const Booking *b);
+static int day_fits_slots(const DayOccupancy *day, const Booking *b, int start, int end);
+void day_add(DayOccupancy *day, const Booking *b);
+void *arena_alloc(Arena *a, size_t size);
+Booking *booking_at(int index);
+Booking *store_append(const Booking *b);
+int schedule_init(Schedule *s, int count);
+void schedule_free(Schedule *s);
+void schedule_slots(const Schedule *s, int index, int *start, int *end);
+void schedule_times(const Schedule *s, int index, char *start, char *end);
+int name_find(NameTable *t, const char *name, size_t len);
+int name_intern(NameTable *t, const char *name, size_t len);
+int group_by_member(const Schedule *s, int byPriority, int *order, MemberGroups *g);
+int booking_minutes(const Booking *b);
+void booking_slots(const Booking *b, int *start, int *end);
+SlotSet slot_range(int start, int end);
+DayOccupancy *day_occupancy(int date, int create);
+void occupancy_add(Booking *b);
+int admit_booking(Booking *b);
 int check_availability(Booking *newBooking);
-int check_availability_temp(Booking *tempBookings, int count, Booking *newBooking);
-void simulate_OPTI(Booking src[], Booking dest[], int count);
-void simulate_PRIO(Booking src[], Booking dest[], int count);
+int schedule_date(const Schedule *s, int index);
+DayOccupancy *opti_day(OptiWork *w, int date);
+int earliest_fit(const DayOccupancy *day, const Booking *b, int len);
+int opti_place(Schedule *s, int index, OptiWork *w);
+void opti_run(Schedule *s, const int *idx, int n);
+int opti_parallel(Schedule *s, int *rejected, int n, int workers);
+void simulate_OPTI(Schedule *s);
+int prio_admit(Schedule *s, int index, PrioDay *day);
+void simulate_PRIO(Schedule *s);
+int sort_by_date(int *idx, int n);
+void exact_search(ExactSearch *e, int depth, int accepted);
+void simulate_OPTI_EXACT(Schedule *s);
 void process_addParking(char *line);
 void process_addReservation(char *line);
 void process_addEvent(char *line);
 void process_bookEssentials(char *line);
 void process_addBatch(char *line);
 void process_printBookings(char *line);
+void process_setOPTI(char *line);
+void stats_add(ScheduleStats *st, const Booking *b);
+void compute_stats(const Schedule *s, ScheduleStats *st);
+void store_publish(void);
+void snapshot_take(Snapshot *snap);
+void write_stats(ReportBuffer *r, const char *name, const ScheduleStats *st, int total);
+int write_all(int fd, const void *buf, size_t len);
+int reporter_start(int shm);
+void report_append(ReportBuffer *r, const char *text, size_t len);
+void report_send(ReportBuffer *r);
+int read_all(int fd, void *buf, size_t len);
+int cache_valid(const ScheduleCache *c, const Snapshot *snap);
+void latency_record(int stat, double start);
+void process_printStats(char *line);
+void journal_booking(const Booking *b, int index);
+void journal_flush(void);
+void journal_commit(void);
+int checkpoint_write(void);
+int journal_open(const char *dir);
+void journal_close(void);
+void cache_store(ScheduleCache *c, Schedule *sched, const ScheduleStats *st, unsigned long generation);
+void cache_clear(ScheduleCache *c);
+const ScheduleCache *cached_schedule(ScheduleCache *c, void (*simulate)(Schedule *), const Snapshot *snap);
+int start_schedule_worker(ScheduleWorker *w, void (*simulate)(Schedule *), const Snapshot *snap);
+int finish_schedule_worker(ScheduleWorker *w, ScheduleCache *c, const Snapshot *snap);
 void process_printSummary(void);
-void process_printOptimized(void);
+void process_printOptimized(const char *algorithm, ScheduleCache *c, void (*simulate)(Schedule *));
 void process_command(char *line);
 char *normalize_member(char *token);
+int report_start(Client *c, char *line);
+void report_finish(Client *c);
+int serve_command(Client *c, char *line);
+int client_run(Client *c);
+int client_read(Client *c);
+int run_server(const char *path);
 
 /* Priority functions: Event = 3, Reservation = 2, Parking = 1, Essentials = 0 */
 int get_priority(const Booking *b) {
-    if (strcmp(b->type, "Event") == 0)
-        return 3;
-    else if (strcmp(b->type, "Reservation") == 0)
-        return 2;
-    else if (strcmp(b->type, "Parking") == 0)
-        return 1;
-    else if (strcmp(b->type, "Essentials") == 0)
-        return 0;
-    return 0;
-}
-
-/* Comparator for qsort (descending order by priority) */
-int cmp_priority(const void *a, const void *b) {
-    const Booking *ba = *(const Booking **)a;
-    const Booking *bb = *(const Booking **)b;
-    return get_priority(bb) - get_priority(ba);
+    return b->type;
 }
 
 /* 若 token 以 '-' (ASCII) 或 en-dash (UTF-8) 開頭，則跳過該符號 */
@@ -89,994 +596,2822 @@ char *normalize_member(char *token) {
     return token;
 }
 
-/* 取得時間字串的時 */
-int get_start_hour(const char *time_str) {
-    int hour, minute;
-    sscanf(time_str, "%d:%d", &hour, &minute);
-    return hour;
+/* 將 hh:mm 時間欄位轉為當日分鐘數，格式錯誤時回傳 -1 */
+int parse_time(const char *text, int len) {
+    int i = 0, hour = 0, minute = 0, digits;
+    for (digits = 0; i < len && text[i] >= '0' && text[i] <= '9'; i++, digits++)
+        hour = hour * 10 + (text[i] - '0');
+    if (digits == 0 || digits > 2)
+        return -1;
+    if (i < len && text[i] == ':') {
+        for (i++, digits = 0; i < len && text[i] >= '0' && text[i] <= '9'; i++, digits++)
+            minute = minute * 10 + (text[i] - '0');
+        if (digits != 2)
+            return -1;
+    }
+    if (i != len || hour > 23 || minute > 59)
+        return -1;
+    return hour * 60 + minute;
 }
 
-/* 若兩預約時間重疊則回傳 1 */
-int times_overlap(Booking *b1, Booking *b2) {
-    int start1 = get_start_hour(b1->time);
-    int start2 = get_start_hour(b2->time);
-    int end1 = start1 + (int)(b1->duration);
-    int end2 = start2 + (int)(b2->duration);
-    return ((start1 < end2) && (start2 < end1));
+/* 由公曆日期計算自 EPOCH_YEAR-01-01 起的日數 */
+static int days_from_civil(int year, int month, int day) {
+    int era, yoe, doy, doe;
+    year -= month <= 2;
+    era = year / 400;
+    yoe = year - era * 400;
+    doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 730425;  /* 730425 = 2000-03-01 起算的偏移 */
 }
 
-/* 檢查預約是否要求某項 essential */
-int essential_requested(Booking *b, const char *ess) {
-    if ((strlen(b->essential1) > 0 && strcmp(b->essential1, ess) == 0) ||
-        (strlen(b->essential2) > 0 && strcmp(b->essential2, ess) == 0) ||
-        (strlen(b->essential3) > 0 && strcmp(b->essential3, ess) == 0))
-        return 1;
-    return 0;
+/* 將 YYYY-MM-DD 日期欄位轉為日數（0 = 2000-01-01），格式錯誤或超出範圍時回傳 -1 */
+int parse_date(const char *text, int len) {
+    static const int monthDays[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int year, month, day, i;
+    if (len != 10 || text[4] != '-' || text[7] != '-')
+        return -1;
+    for (i = 0; i < len; i++) {
+        if (i != 4 && i != 7 && (text[i] < '0' || text[i] > '9'))
+            return -1;
+    }
+    year = (text[0] - '0') * 1000 + (text[1] - '0') * 100 + (text[2] - '0') * 10 + (text[3] - '0');
+    month = (text[5] - '0') * 10 + (text[6] - '0');
+    day = (text[8] - '0') * 10 + (text[9] - '0');
+    if (year < EPOCH_YEAR || year >= EPOCH_YEAR + MAX_YEARS || month < 1 || month > 12 ||
+        day < 1 || day > monthDays[month - 1])
+        return -1;
+    if (month == 2 && day == 29 && !(year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)))
+        return -1;
+    return days_from_civil(year, month, day) - days_from_civil(EPOCH_YEAR, 1, 1);
 }
 
-/* FCFS: 檢查全局預約中資源是否足夠 */
-int check_availability(Booking *newBooking) {
-    int i, count;
-    if (newBooking->requires_parking) {
-        count = 0;
-        for (i = 0; i < bookingCount; i++) {
-            if (bookings[i].accepted &&
-                strcmp(bookings[i].date, newBooking->date) == 0 &&
-                bookings[i].requires_parking) {
-                if (times_overlap(&bookings[i], newBooking))
-                    count++;
-            }
+/* 將日數格式化為 YYYY-MM-DD，buf 至少 11 個位元組 */
+const char *format_date(int day, char *buf) {
+    int z = day + days_from_civil(EPOCH_YEAR, 1, 1) + 730425;
+    int era = z / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int d = doy - (153 * mp + 2) / 5 + 1;
+    int m = mp < 10 ? mp + 3 : mp - 9;
+    int y = yoe + era * 400 + (m <= 2);
+    sprintf(buf, "%04d-%02d-%02d", y, m, d);
+    return buf;
+}
+
+/* 解析以小時為單位的時長欄位（如 3 或 1.5），格式錯誤時回傳 0 */
+int parse_duration(const char *text, int len, float *hours) {
+    int i = 0, digits = 0;
+    double value = 0.0, scale = 1.0;
+    for (; i < len && text[i] >= '0' && text[i] <= '9'; i++, digits++)
+        value = value * 10.0 + (text[i] - '0');
+    if (i < len && text[i] == '.') {
+        for (i++; i < len && text[i] >= '0' && text[i] <= '9'; i++, digits++) {
+            scale /= 10.0;
+            value += (text[i] - '0') * scale;
         }
-        if (count >= PARKING_CAPACITY)
-            return 0;
     }
-    if (strlen(newBooking->essential1) > 0) {
-        count = 0;
-        for (i = 0; i < bookingCount; i++) {
-            if (bookings[i].accepted && strcmp(bookings[i].date, newBooking->date) == 0) {
-                if (times_overlap(&bookings[i], newBooking)) {
-                    if (essential_requested(&bookings[i], newBooking->essential1))
-                        count++;
-                }
-            }
-        }
-        if (count >= ESSENTIAL_CAPACITY)
-            return 0;
+    if (digits == 0 || i != len)
+        return 0;
+    *hours = (float)value;
+    return 1;
+}
+
+/* 檢查預約是否要求某項 essential */
+int essential_requested(const Booking *b, int device) {
+    return (b->essentials >> device) & 1u;
+}
+
+/* 取得設備名稱對應的位元遮罩，未曾出現的設備回傳 0 */
+unsigned int device_mask(const char *name) {
+    int id = name_find(&deviceTable, name, strlen(name));
+    return id < 0 ? 0u : 1u << id;
+}
+
+/* 取得預約第 k 項設備的名稱，未指定時回傳空字串 */
+const char *device_name(const Booking *b, int k) {
+    if (b->device[k] == NO_DEVICE)
+        return "";
+    return deviceTable.names[b->device[k]];
+}
+
+/* 將預約前 maxDevices 項設備名稱以空白連接寫入 buf（最多 size 位元組），
+   未指定任何設備時寫入 none */
+void device_list(const Booking *b, int maxDevices, const char *none, char *buf, size_t size) {
+    size_t len = 0;
+    int k;
+    buf[0] = '\0';
+    for (k = 0; k < maxDevices && len < size; k++) {
+        if (b->device[k] != NO_DEVICE)
+            len += (size_t)snprintf(buf + len, size - len, "%s%s", len > 0 ? " " : "", device_name(b, k));
     }
-    if (strlen(newBooking->essential2) > 0) {
-        count = 0;
-        for (i = 0; i < bookingCount; i++) {
-            if (bookings[i].accepted && strcmp(bookings[i].date, newBooking->date) == 0) {
-                if (times_overlap(&bookings[i], newBooking)) {
-                    if (essential_requested(&bookings[i], newBooking->essential2))
-                        count++;
-                }
-            }
-        }
-        if (count >= ESSENTIAL_CAPACITY)
-            return 0;
+    if (len == 0)
+        snprintf(buf, size, "%s", none);
+}
+
+/* 從 arena 配置記憶體（16 位元組對齊），不足時向系統索取新的區塊 */
+void *arena_alloc(Arena *a, size_t size) {
+    const size_t header = (sizeof(ArenaBlock) + 15) & ~(size_t)15;
+    ArenaBlock *blk = a->head;
+    void *p;
+    size = (size + 15) & ~(size_t)15;
+    if (blk == NULL || blk->size - blk->used < size) {
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        blk = (ArenaBlock *)malloc(header + blockSize);
+        if (blk == NULL)
+            return NULL;
+        blk->next = a->head;
+        blk->size = blockSize;
+        blk->used = 0;
+        a->head = blk;
     }
-    if (strlen(newBooking->essential3) > 0) {
-        count = 0;
-        for (i = 0; i < bookingCount; i++) {
-            if (bookings[i].accepted && strcmp(bookings[i].date, newBooking->date) == 0) {
-                if (times_overlap(&bookings[i], newBooking)) {
-                    if (essential_requested(&bookings[i], newBooking->essential3))
-                        count++;
-                }
-            }
-        }
-        if (count >= ESSENTIAL_CAPACITY)
-            return 0;
+    p = (char *)blk + header + blk->used;
+    blk->used += size;
+    return p;
+}
+
+/* 依索引取得預約記錄 */
+Booking *booking_at(int index) {
+    return &store.chunks[index >> CHUNK_SHIFT][index & (CHUNK_SIZE - 1)];
+}
+
+/* 將預約加入儲存區末端，必要時配置新的 chunk；失敗時回傳 NULL */
+Booking *store_append(const Booking *b) {
+    /* 預約 chunk 與其欄位 chunk 一次配置，不會只配置到其中一個 */
+    const size_t bookingBytes = (sizeof(Booking) * CHUNK_SIZE + 15) & ~(size_t)15;
+    Booking *slot;
+    ColumnChunk *col;
+    char *block;
+    int i;
+    if ((store.count >> CHUNK_SHIFT) == store.chunkCount) {
+        if (store.chunkCount == MAX_CHUNKS)
+            return NULL;
+        block = (char *)arena_alloc(&arena, bookingBytes + sizeof(ColumnChunk));
+        if (block == NULL)
+            return NULL;
+        store.chunks[store.chunkCount] = (Booking *)block;
+        store.columns[store.chunkCount] = (ColumnChunk *)(block + bookingBytes);
+        store.chunkCount++;
+    }
+    slot = booking_at(store.count);
+    *slot = *b;
+    col = store.columns[store.count >> CHUNK_SHIFT];
+    i = store.count & (CHUNK_SIZE - 1);
+    col->date[i] = b->date;
+    col->start[i] = b->start;
+    col->duration[i] = b->duration;
+    col->type[i] = b->type;
+    col->essentials[i] = b->essentials;
+    col->accepted[i] = b->accepted;
+    store.count++;
+    store.generation++;
+    if (journal.fd >= 0)
+        journal_booking(slot, store.count - 1);
+    return slot;
+}
+
+/* 建立排程結果，初始值為 FCFS 的接受狀態及原定時間 */
+int schedule_init(Schedule *s, int count) {
+    int i;
+    s->count = count;
+    s->accepted = (unsigned char *)malloc((size_t)(count > 0 ? count : 1));
+    s->startSlot = (short *)malloc(sizeof(short) * (size_t)(count > 0 ? count : 1));
+    s->dayShift = (short *)calloc((size_t)(count > 0 ? count : 1), sizeof(short));
+    s->search = 0;
+    s->preempted = 0;
+    if (s->accepted == NULL || s->startSlot == NULL || s->dayShift == NULL) {
+        schedule_free(s);
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        s->accepted[i] = (unsigned char)booking_at(i)->accepted;
+        s->startSlot[i] = -1;
     }
     return 1;
 }
 
-/* 與上面類似，但作用於傳入的 tempBookings 陣列 */
-int check_availability_temp(Booking *tempBookings, int count, Booking *newBooking) {
-    int i, c;
-    if (newBooking->requires_parking) {
-        c = 0;
-        for (i = 0; i < count; i++) {
-            if (tempBookings[i].accepted &&
-                strcmp(tempBookings[i].date, newBooking->date) == 0 &&
-                tempBookings[i].requires_parking) {
-                if (times_overlap(&tempBookings[i], newBooking))
-                    c++;
-            }
-        }
-        if (c >= PARKING_CAPACITY)
-            return 0;
+void schedule_free(Schedule *s) {
+    free(s->accepted);
+    free(s->startSlot);
+    free(s->dayShift);
+    s->accepted = NULL;
+    s->startSlot = NULL;
+    s->dayShift = NULL;
+    s->count = 0;
+}
+
+/* 取得預約在排程中的日期 */
+int schedule_date(const Schedule *s, int index) {
+    return booking_at(index)->date + s->dayShift[index];
+}
+
+/* 取得預約在排程中佔用的時段範圍 [start, end) */
+void schedule_slots(const Schedule *s, int index, int *start, int *end) {
+    const Booking *b = booking_at(index);
+    if (s->startSlot[index] >= 0) {
+        *start = s->startSlot[index];
+        *end = *start + (booking_minutes(b) + SLOT_MINUTES - 1) / SLOT_MINUTES;
+        if (*end > SLOTS_PER_DAY)
+            *end = SLOTS_PER_DAY;
+    } else {
+        booking_slots(b, start, end);
     }
-    if (strlen(newBooking->essential1) > 0) {
-        c = 0;
-        for (i = 0; i < count; i++) {
-            if (tempBookings[i].accepted && strcmp(tempBookings[i].date, newBooking->date) == 0) {
-                if (times_overlap(&tempBookings[i], newBooking)) {
-                    if (essential_requested(&tempBookings[i], newBooking->essential1))
-                        c++;
-                }
-            }
-        }
-        if (c >= ESSENTIAL_CAPACITY)
-            return 0;
+}
+
+/* 取得預約在排程中的開始及結束時間字串（供報告輸出） */
+void schedule_times(const Schedule *s, int index, char *start, char *end) {
+    const Booking *b = booking_at(index);
+    int from = s->startSlot[index] >= 0 ? s->startSlot[index] * SLOT_MINUTES : b->start;
+    int to = from + booking_minutes(b);
+    sprintf(start, "%02d:%02d", from / 60, from % 60);
+    sprintf(end, "%02d:%02d", to / 60, to % 60);
+}
+
+/* FNV-1a hash of a (not necessarily terminated) string */
+static unsigned long name_hash(const char *name, size_t len) {
+    unsigned long h = 2166136261UL;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619UL;
     }
-    if (strlen(newBooking->essential2) > 0) {
-        c = 0;
-        for (i = 0; i < count; i++) {
-            if (tempBookings[i].accepted && strcmp(tempBookings[i].date, newBooking->date) == 0) {
-                if (times_overlap(&tempBookings[i], newBooking)) {
-                    if (essential_requested(&tempBookings[i], newBooking->essential2))
-                        c++;
-                }
-            }
-        }
-        if (c >= ESSENTIAL_CAPACITY)
-            return 0;
+    return h;
+}
+
+/* 在名稱表中查找名稱，找不到回傳 -1 */
+int name_find(NameTable *t, const char *name, size_t len) {
+    unsigned long i;
+    int id;
+    if (t->slotCount == 0)
+        return -1;
+    i = name_hash(name, len) & (unsigned long)(t->slotCount - 1);
+    while ((id = t->slots[i]) != 0) {
+        if (strncmp(t->names[id - 1], name, len) == 0 && t->names[id - 1][len] == '\0')
+            return id - 1;
+        i = (i + 1) & (unsigned long)(t->slotCount - 1);
     }
-    if (strlen(newBooking->essential3) > 0) {
-        c = 0;
-        for (i = 0; i < count; i++) {
-            if (tempBookings[i].accepted && strcmp(tempBookings[i].date, newBooking->date) == 0) {
-                if (times_overlap(&tempBookings[i], newBooking)) {
-                    if (essential_requested(&tempBookings[i], newBooking->essential3))
-                        c++;
-                }
-            }
-        }
-        if (c >= ESSENTIAL_CAPACITY)
-            return 0;
+    return -1;
+}
+
+/* 重新建立雜湊表，使負載率保持在一半以下 */
+static int name_rehash(NameTable *t, int slotCount) {
+    int *slots;
+    int id;
+    unsigned long i;
+    slots = (int *)calloc((size_t)slotCount, sizeof(int));
+    if (slots == NULL)
+        return 0;
+    for (id = 0; id < t->count; id++) {
+        i = name_hash(t->names[id], strlen(t->names[id])) & (unsigned long)(slotCount - 1);
+        while (slots[i] != 0)
+            i = (i + 1) & (unsigned long)(slotCount - 1);
+        slots[i] = id + 1;
     }
+    free(t->slots);
+    t->slots = slots;
+    t->slotCount = slotCount;
     return 1;
 }
 
-/* 模擬 OPTI 調度：複製 src 到 dest，並嘗試調整未被接受預約的開始時間（08:00-20:00），不改變全局資料 */
-void simulate_OPTI(Booking src[], Booking dest[], int count) {
-    int i, h;
-    char newTime[6];
-    char oldTime[6];
-    for (i = 0; i < count; i++) {
-        dest[i] = src[i];
-    }
-    for (i = 0; i < count; i++) {
-        if (!dest[i].accepted) {
-            strcpy(oldTime, dest[i].time);
-            for (h = 8; h <= 20; h++) {
-                sprintf(newTime, "%02d:00", h);
-                strcpy(dest[i].time, newTime);
-                if (check_availability_temp(dest, count, &dest[i])) {
-                    dest[i].accepted = 1;
-                    break;
-                } else {
-                    strcpy(dest[i].time, oldTime);
-                }
-            }
-        }
+/* 取得名稱對應的 id，若不存在則新增；名稱超過 MAX_NAME_LENGTH（如來自損壞的
+   檢查點或日誌）、超出上限或記憶體不足時回傳 -1 */
+int name_intern(NameTable *t, const char *name, size_t len) {
+    int id;
+    char *copy;
+    unsigned long i;
+    if (len > MAX_NAME_LENGTH)
+        return -1;
+    id = name_find(t, name, len);
+    if (id >= 0)
+        return id;
+    if (t->limit > 0 && t->count >= t->limit)
+        return -1;
+    if (t->count == t->capacity) {
+        int newCapacity = t->capacity ? t->capacity * 2 : 16;
+        char **names = (char **)realloc(t->names, sizeof(char *) * (size_t)newCapacity);
+        if (names == NULL)
+            return -1;
+        t->names = names;
+        t->capacity = newCapacity;
     }
+    if ((t->count + 1) * 2 > t->slotCount &&
+        !name_rehash(t, t->slotCount ? t->slotCount * 2 : NAME_HASH_MIN))
+        return -1;
+    copy = (char *)malloc(len + 1);
+    if (copy == NULL)
+        return -1;
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    id = t->count++;
+    t->names[id] = copy;
+    i = name_hash(name, len) & (unsigned long)(t->slotCount - 1);
+    while (t->slots[i] != 0)
+        i = (i + 1) & (unsigned long)(t->slotCount - 1);
+    t->slots[i] = id + 1;
+    return id;
 }
 
-/* 模擬 PRIO 調度（搶占機制）：
-   先複製 src 到 dest，按到達順序處理，
-   只有在某資源（如停車位或必需設備）使用數量達到上限時，
-   才嘗試搶占與新預約重疊且優先權較低的預約，否則直接接受。
-*/
-void simulate_PRIO(Booking src[], Booking dest[], int count) {
-    int i, j;
-    /* 複製所有預約，並初始化 accepted 為 0 */
-    for (i = 0; i < count; i++) {
-        dest[i] = src[i];
-        dest[i].accepted = 0;
+/* 預約時長換算成分鐘 */
+int booking_minutes(const Booking *b) {
+    return (int)(b->duration * 60.0f + 0.5f);
+}
+
+/* 取得預約佔用的時段範圍 [start, end)：涵蓋預約時間的每個 15 分鐘時段都算佔用，
+   限制在當日之內 */
+void booking_slots(const Booking *b, int *start, int *end) {
+    *start = b->start / SLOT_MINUTES;
+    *end = (b->start + booking_minutes(b) + SLOT_MINUTES - 1) / SLOT_MINUTES;
+    if (*start < 0)
+        *start = 0;
+    if (*end > SLOTS_PER_DAY)
+        *end = SLOTS_PER_DAY;
+    if (*end < *start)
+        *end = *start;
+}
+
+/* 建立時段 [start, end) 的位元集合 */
+SlotSet slot_range(int start, int end) {
+    SlotSet r;
+    int k, lo, hi;
+    for (k = 0; k < SLOT_WORDS; k++) {
+        lo = start - k * 64;
+        hi = end - k * 64;
+        if (lo < 0) lo = 0;
+        if (hi > 64) hi = 64;
+        if (lo >= hi)
+            r.w[k] = 0;
+        else
+            r.w[k] = (hi - lo == 64 ? ~0ULL : ((1ULL << (hi - lo)) - 1)) << lo;
     }
-    /* 按到達順序處理每筆預約 */
-    for (i = 0; i < count; i++) {
-        if (check_availability_temp(dest, i, &dest[i])) {
-            dest[i].accepted = 1;
-        } else {
-            /* 檢查各項資源是否真正耗盡，若是，則嘗試搶占低優先權預約 */
-            /* 停車位 */
-            if (dest[i].requires_parking) {
-                int count_parking = 0;
-                for (j = 0; j < i; j++) {
-                    if (dest[j].accepted &&
-                        strcmp(dest[j].date, dest[i].date) == 0 &&
-                        dest[j].requires_parking &&
-                        times_overlap(&dest[j], &dest[i]))
-                    {
-                        count_parking++;
-                    }
-                }
-                if (count_parking >= PARKING_CAPACITY) {
-                    for (j = 0; j < i; j++) {
-                        if (dest[j].accepted &&
-                            strcmp(dest[j].date, dest[i].date) == 0 &&
-                            dest[j].requires_parking &&
-                            times_overlap(&dest[j], &dest[i]) &&
-                            get_priority(&dest[j]) < get_priority(&dest[i]))
-                        {
-                            dest[j].accepted = 0;
-                            if (check_availability_temp(dest, i, &dest[i]))
-                                break;
-                        }
-                    }
-                }
-            }
-            /* essential1 */
-            if (strlen(dest[i].essential1) > 0) {
-                int count_ess1 = 0;
-                for (j = 0; j < i; j++) {
-                    if (dest[j].accepted &&
-                        strcmp(dest[j].date, dest[i].date) == 0 &&
-                        times_overlap(&dest[j], &dest[i]) &&
-                        essential_requested(&dest[j], dest[i].essential1))
-                    {
-                        count_ess1++;
-                    }
-                }
-                if (count_ess1 >= ESSENTIAL_CAPACITY) {
-                    for (j = 0; j < i; j++) {
-                        if (dest[j].accepted &&
-                            strcmp(dest[j].date, dest[i].date) == 0 &&
-                            times_overlap(&dest[j], &dest[i]) &&
-                            essential_requested(&dest[j], dest[i].essential1) &&
-                            get_priority(&dest[j]) < get_priority(&dest[i]))
-                        {
-                            dest[j].accepted = 0;
-                            if (check_availability_temp(dest, i, &dest[i]))
-                                break;
-                        }
-                    }
-                }
-            }
-            /* essential2 */
-            if (strlen(dest[i].essential2) > 0) {
-                int count_ess2 = 0;
-                for (j = 0; j < i; j++) {
-                    if (dest[j].accepted &&
-                        strcmp(dest[j].date, dest[i].date) == 0 &&
-                        times_overlap(&dest[j], &dest[i]) &&
-                        essential_requested(&dest[j], dest[i].essential2))
-                    {
-                        count_ess2++;
-                    }
-                }
-                if (count_ess2 >= ESSENTIAL_CAPACITY) {
-                    for (j = 0; j < i; j++) {
-                        if (dest[j].accepted &&
-                            strcmp(dest[j].date, dest[i].date) == 0 &&
-                            times_overlap(&dest[j], &dest[i]) &&
-                            essential_requested(&dest[j], dest[i].essential2) &&
-                            get_priority(&dest[j]) < get_priority(&dest[i]))
-                        {
-                            dest[j].accepted = 0;
-                            if (check_availability_temp(dest, i, &dest[i]))
-                                break;
-                        }
-                    }
-                }
-            }
-            /* essential3 */
-            if (strlen(dest[i].essential3) > 0) {
-                int count_ess3 = 0;
-                for (j = 0; j < i; j++) {
-                    if (dest[j].accepted &&
-                        strcmp(dest[j].date, dest[i].date) == 0 &&
-                        times_overlap(&dest[j], &dest[i]) &&
-                        essential_requested(&dest[j], dest[i].essential3))
-                    {
-                        count_ess3++;
-                    }
-                }
-                if (count_ess3 >= ESSENTIAL_CAPACITY) {
-                    for (j = 0; j < i; j++) {
-                        if (dest[j].accepted &&
-                            strcmp(dest[j].date, dest[i].date) == 0 &&
-                            times_overlap(&dest[j], &dest[i]) &&
-                            essential_requested(&dest[j], dest[i].essential3) &&
-                            get_priority(&dest[j]) < get_priority(&dest[i]))
-                        {
-                            dest[j].accepted = 0;
-                            if (check_availability_temp(dest, i, &dest[i]))
-                                break;
-                        }
-                    }
-                }
-            }
-            if (check_availability_temp(dest, i, &dest[i])) {
-                dest[i].accepted = 1;
-            } else {
-                dest[i].accepted = 0;
-            }
-        }
+    return r;
+}
+
+/* 資源在 range 內是否已滿：只需檢查最高一層 */
+static int level_full(const SlotSet *levels, int capacity, const SlotSet *range) {
+    int k;
+    for (k = 0; k < SLOT_WORDS; k++) {
+        if (levels[capacity - 1].w[k] & range->w[k])
+            return 1;
     }
+    return 0;
 }
 
-/* 以下為使用者命令處理函式 */
+/* 在 range 內將資源用量加一：由上而下，每層補上下一層已佔用的位元 */
+static void level_add(SlotSet *levels, int capacity, const SlotSet *range) {
+    int lv, k;
+    for (k = 0; k < SLOT_WORDS; k++) {
+        for (lv = capacity - 1; lv > 0; lv--)
+            levels[lv].w[k] |= levels[lv - 1].w[k] & range->w[k];
+        levels[0].w[k] |= range->w[k];
+    }
+}
 
-/* addParking -member_X YYYY-MM-DD hh:mm duration [essential1 essential2]; */
-void process_addParking(char *line) {
-    char *token;
-    Booking b;
-    int i;
-    for (i = 0; i < (int)sizeof(b); i++) {
-        ((char *)&b)[i] = 0;
+/* 在 range 內將資源用量減一：每層改為上一層在 range 內的內容 */
+static void level_remove(SlotSet *levels, int capacity, const SlotSet *range) {
+    int lv, k;
+    for (k = 0; k < SLOT_WORDS; k++) {
+        for (lv = 0; lv < capacity - 1; lv++)
+            levels[lv].w[k] = (levels[lv].w[k] & ~range->w[k]) | (levels[lv + 1].w[k] & range->w[k]);
+        levels[capacity - 1].w[k] &= ~range->w[k];
     }
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.member, normalize_member(token));
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.date, token);
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.time, token);
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    b.duration = (float)atof(token);
-    token = strtok(NULL, " ;\n");
-    if (token != NULL) {
-        strcpy(b.essential1, token);
-        token = strtok(NULL, " ;\n");
-        if (token != NULL)
-            strcpy(b.essential2, token);
-    }
-    strcpy(b.type, "Parking");
-    b.requires_parking = 1;
-    b.accepted = check_availability(&b) ? 1 : 0;
-    bookings[bookingCount++] = b;
-    printf("-> [Pending]\n");
 }
 
-/* addReservation -member_X YYYY-MM-DD hh:mm duration essential1 essential2; */
-void process_addReservation(char *line) {
-    char *token;
-    Booking b;
-    int i;
-    for (i = 0; i < (int)sizeof(b); i++) {
-        ((char *)&b)[i] = 0;
+/* 取得某日的佔用資料；create 為 0 且該日尚無預約時回傳 NULL。
+   分片收錄時由擁有該日期的執行緒呼叫，因此以 calloc 配置而不經過共用的 arena */
+DayOccupancy *day_occupancy(int date, int create) {
+    if (occupancy[date] == NULL && create)
+        occupancy[date] = (DayOccupancy *)calloc(1, sizeof(DayOccupancy));
+    return occupancy[date];
+}
+
+/* 將已接受的預約計入佔用索引 */
+void occupancy_add(Booking *b) {
+    DayOccupancy *day = day_occupancy(b->date, 1);
+    if (day != NULL)
+        day_add(day, b);
+}
+
+/* 將預約在時段 [start, end) 計入某日期的佔用 */
+static void day_add_slots(DayOccupancy *day, const Booking *b, int start, int end) {
+    unsigned int mask;
+    int d;
+    SlotSet range = slot_range(start, end);
+    if (b->requires_parking)
+        level_add(day->parking, PARKING_CAPACITY, &range);
+    for (mask = b->essentials, d = 0; mask != 0; mask >>= 1, d++) {
+        if (mask & 1u)
+            level_add(day->device[d], ESSENTIAL_CAPACITY, &range);
     }
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.member, normalize_member(token));
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.date, token);
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.time, token);
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    b.duration = (float)atof(token);
-    token = strtok(NULL, " ;\n");
-    if (token != NULL) {
-        strcpy(b.essential1, token);
-        token = strtok(NULL, " ;\n");
-        if (token != NULL)
-            strcpy(b.essential2, token);
-    }
-    strcpy(b.type, "Reservation");
-    b.requires_parking = 1;
-    b.accepted = check_availability(&b) ? 1 : 0;
-    bookings[bookingCount++] = b;
-    printf("-> [Pending]\n");
 }
 
-/* addEvent -member_X YYYY-MM-DD hh:mm duration essential1 essential2 essential3; */
-void process_addEvent(char *line) {
-    char *token;
-    Booking b;
-    int i;
-    for (i = 0; i < (int)sizeof(b); i++) {
-        ((char *)&b)[i] = 0;
+/* 將預約在時段 [start, end) 移出某日期的佔用 */
+static void day_remove_slots(DayOccupancy *day, const Booking *b, int start, int end) {
+    unsigned int mask;
+    int d;
+    SlotSet range = slot_range(start, end);
+    if (b->requires_parking)
+        level_remove(day->parking, PARKING_CAPACITY, &range);
+    for (mask = b->essentials, d = 0; mask != 0; mask >>= 1, d++) {
+        if (mask & 1u)
+            level_remove(day->device[d], ESSENTIAL_CAPACITY, &range);
     }
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.member, normalize_member(token));
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.date, token);
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.time, token);
-    token = strtok(NULL, " ");
+}
+
+/* 將預約計入某日期的時段佔用 */
+void day_add(DayOccupancy *day, const Booking *b) {
+    int start, end;
+    booking_slots(b, &start, &end);
+    day_add_slots(day, b, start, end);
+}
+
+/* FCFS: 利用佔用索引檢查資源是否足夠，每項資源只需對預約時段做幾次位元 AND */
+int check_availability(Booking *newBooking) {
+    DayOccupancy *day = day_occupancy(newBooking->date, 0);
+    return day == NULL || day_fits(day, newBooking);
+}
+
+/* 檢查預約涵蓋的時段在某日期的佔用下是否仍有空位 */
+int day_fits(const DayOccupancy *day, const Booking *b) {
+    int start, end;
+    booking_slots(b, &start, &end);
+    return day_fits_slots(day, b, start, end);
+}
+
+/* 檢查時段 [start, end) 在某日期的佔用下是否仍可容納預約所需的各項資源 */
+static int day_fits_slots(const DayOccupancy *day, const Booking *b, int start, int end) {
+    unsigned int mask;
+    int d;
+    SlotSet range = slot_range(start, end);
+    if (b->requires_parking && level_full(day->parking, PARKING_CAPACITY, &range))
+        return 0;
+    for (mask = b->essentials, d = 0; mask != 0; mask >>= 1, d++) {
+        if ((mask & 1u) && level_full(day->device[d], ESSENTIAL_CAPACITY, &range))
+            return 0;
+    }
+    return 1;
+}
+
+/* FCFS 收錄：檢查資源後存入儲存區，接受時同時更新佔用索引；儲存失敗回傳 0 */
+int admit_booking(Booking *b) {
+    b->accepted = check_availability(b) ? 1 : 0;
+    if (store_append(b) == NULL) {
+        printf("Error: Booking store is full\n");
+        return 0;
+    }
+    if (b->accepted)
+        occupancy_add(b);
+    stats_add(&fcfsStats, b);
+    store_publish();
+    return 1;
+}
+
+/* 將一筆預約的決定計入統計 */
+void stats_add(ScheduleStats *st, const Booking *b) {
+    unsigned int mask;
+    int d;
+    if (!b->accepted) {
+        st->rejected++;
+        return;
+    }
+    st->accepted++;
+    if (b->date < st->earliest) st->earliest = b->date;
+    if (b->date > st->latest) st->latest = b->date;
+    if (b->requires_parking)
+        st->parkingHours += b->duration;
+    for (mask = b->essentials, d = 0; mask != 0; mask >>= 1, d++) {
+        if (mask & 1u)
+            st->deviceHours[d] += b->duration;
+    }
+}
+
+/* 取得 OPTI 使用的某日佔用資料，首次使用時配置；超出範圍回傳 NULL */
+DayOccupancy *opti_day(OptiWork *w, int date) {
+    DayOccupancy **slot;
+    if (date < w->lo || date > w->hi)
+        return NULL;
+    slot = &w->days[date - w->lo];
+    if (*slot == NULL)
+        *slot = (DayOccupancy *)calloc(1, sizeof(DayOccupancy));
+    return *slot;
+}
+
+/* 在 day 的剩餘容量中為預約找最早可用、長度 len 的開始時段（08:00-20:00），找不到回傳 -1。
+   各項所需資源已滿的時段合併成一個集合後，由後往前掃描一次計算每個時段起的連續空閒長度 */
+int earliest_fit(const DayOccupancy *day, const Booking *b, int len) {
+    unsigned int mask;
+    int k, d, t, run, need, found = -1;
+    SlotSet full;
+    for (k = 0; k < SLOT_WORDS; k++)
+        full.w[k] = b->requires_parking ? day->parking[PARKING_CAPACITY - 1].w[k] : 0;
+    for (mask = b->essentials, d = 0; mask != 0; mask >>= 1, d++) {
+        if (mask & 1u) {
+            for (k = 0; k < SLOT_WORDS; k++)
+                full.w[k] |= day->device[d][ESSENTIAL_CAPACITY - 1].w[k];
+        }
+    }
+    run = 0;  /* 時段 t 起的連續空閒時段數，當日結束後視為空閒 */
+    for (t = SLOTS_PER_DAY - 1; t >= OPTI_FIRST_SLOT; t--) {
+        run = ((full.w[t >> 6] >> (t & 63)) & 1ULL) ? 0 : run + 1;
+        need = t + len > SLOTS_PER_DAY ? SLOTS_PER_DAY - t : len;
+        if (t <= OPTI_LAST_SLOT && run >= need)
+            found = t;
+    }
+    return found;
+}
+
+/* 為一筆被拒絕的預約在原日期及前後 optiDays 日內各找最早可用的時段，
+   取成本（移動日數 x optiDayCost + 移動小時數）最低者，同成本時取移動日數較少、日期較早者；
+   找到時更新排程及該日佔用並回傳 1 */
+int opti_place(Schedule *s, int index, OptiWork *w) {
+    const Booking *b = booking_at(index);
+    int len = (booking_minutes(b) + SLOT_MINUTES - 1) / SLOT_MINUTES;
+    int k, off, slot, bestOff = 0, bestSlot = -1;
+    double cost, bestCost = 0.0;
+    DayOccupancy *day;
+    for (k = 0; k <= 2 * optiDays; k++) {
+        off = (k + 1) / 2 * (k % 2 ? -1 : 1);  /* 0, -1, +1, -2, +2, ... */
+        day = opti_day(w, b->date + off);
+        if (day == NULL)
+            continue;
+        slot = earliest_fit(day, b, len);
+        if (slot < 0)
+            continue;
+        cost = optiDayCost * abs(off) + abs(slot * SLOT_MINUTES - b->start) / 60.0;
+        if (bestSlot < 0 || cost < bestCost) {
+            bestCost = cost;
+            bestOff = off;
+            bestSlot = slot;
+        }
+    }
+    if (bestSlot < 0)
+        return 0;
+    s->startSlot[index] = (short)bestSlot;
+    s->dayShift[index] = (short)bestOff;
+    s->accepted[index] = 1;
+    day_add_slots(opti_day(w, b->date + bestOff), b, bestSlot,
+                  bestSlot + len > SLOTS_PER_DAY ? SLOTS_PER_DAY : bestSlot + len);
+    return 1;
+}
+
+/* 依 idx 的順序為被拒絕的預約尋找時段。涉及日期（含前後 optiDays 日）的佔用由排程中
+   已接受的預約重建，而非讀取持續更新的 FCFS 佔用索引，因此結果只取決於排程所屬的快照 */
+void opti_run(Schedule *s, const int *idx, int n) {
+    OptiWork w;
+    DayOccupancy *day;
+    int i, date, start, end;
+    w.lo = MAX_DAYS;
+    w.hi = -1;
+    for (i = 0; i < n; i++) {
+        date = booking_at(idx[i])->date;
+        if (date < w.lo) w.lo = date;
+        if (date > w.hi) w.hi = date;
+    }
+    if (w.hi < w.lo)
+        return;
+    w.lo = w.lo - optiDays < 0 ? 0 : w.lo - optiDays;
+    w.hi = w.hi + optiDays >= MAX_DAYS ? MAX_DAYS - 1 : w.hi + optiDays;
+    w.days = (DayOccupancy **)calloc((size_t)(w.hi - w.lo) + 1, sizeof(DayOccupancy *));
+    if (w.days == NULL)
+        return;
+    for (i = 0; i < s->count; i++) {
+        if (s->accepted[i] && (day = opti_day(&w, schedule_date(s, i))) != NULL) {
+            schedule_slots(s, i, &start, &end);
+            day_add_slots(day, booking_at(i), start, end);
+        }
+    }
+    for (i = 0; i < n; i++)
+        opti_place(s, idx[i], &w);
+    for (date = w.lo; date <= w.hi; date++)
+        free(w.days[date - w.lo]);
+    free(w.days);
+}
+
+/* 依日期把被拒絕的預約分成 workers 段（只在日期交界處切開，各段筆數相近），
+   每段交由一個子行程處理並經 pipe 傳回開始時段，父行程依段的順序合併，結果與單一行程相同。
+   無法建立子行程的段由父行程自行處理。記憶體不足時回傳 0 */
+int opti_parallel(Schedule *s, int *rejected, int n, int workers) {
+    pid_t pids[MAX_OPTI_WORKERS];
+    int fds[MAX_OPTI_WORKERS], first[MAX_OPTI_WORKERS + 1];
+    int parts = 0, i, k, pipefd[2];
+    if (!sort_by_date(rejected, n))
+        return 0;
+    first[0] = 0;
+    for (k = 1; k < workers; k++) {
+        i = (int)((long)n * k / workers);
+        if (i <= first[parts])
+            continue;
+        while (i < n && booking_at(rejected[i])->date == booking_at(rejected[i - 1])->date)
+            i++;
+        if (i >= n)
+            break;
+        first[++parts] = i;
+    }
+    first[++parts] = n;
+
+    fflush(stdout);
+    for (k = 0; k < parts; k++) {
+        pids[k] = -1;
+        if (pipe(pipefd) == -1)
+            continue;
+        pids[k] = fork();
+        if (pids[k] == 0) {  /* 子行程：處理一段日期並寫回各預約的開始時段 */
+            close(pipefd[0]);
+            opti_run(s, rejected + first[k], first[k + 1] - first[k]);
+            for (i = first[k]; i < first[k + 1]; i++) {
+                if (!write_all(pipefd[1], &s->startSlot[rejected[i]], sizeof(short)))
+                    _exit(1);
+            }
+            _exit(0);
+        }
+        close(pipefd[1]);
+        fds[k] = pipefd[0];
+        if (pids[k] < 0)
+            close(fds[k]);
+    }
+    for (k = 0; k < parts; k++) {
+        int ok = pids[k] > 0;
+        for (i = first[k]; ok && i < first[k + 1]; i++) {
+            ok = read_all(fds[k], &s->startSlot[rejected[i]], sizeof(short));
+            s->accepted[rejected[i]] = s->startSlot[rejected[i]] >= 0;
+        }
+        if (pids[k] > 0) {
+            close(fds[k]);
+            waitpid(pids[k], NULL, 0);
+        }
+        if (!ok) {  /* 子行程失敗：由本行程重新處理這一段 */
+            for (i = first[k]; i < first[k + 1]; i++) {
+                s->startSlot[rejected[i]] = -1;
+                s->accepted[rejected[i]] = 0;
+            }
+            opti_run(s, rejected + first[k], first[k + 1] - first[k]);
+        }
+    }
+    return 1;
+}
+
+/* 模擬 OPTI 調度：以 FCFS 結果為起點（s 須由 schedule_init 建立），
+   依到達順序為未被接受的預約在 08:00-20:00 之間尋找時段，可移往前後 optiDays 日內。
+   optiDays 為 0 時各日期互不影響，被拒絕的預約夠多時依日期分給多個子行程同時處理；
+   結果只寫入排程 s，不改變全局資料 */
+void simulate_OPTI(Schedule *s) {
+    int *rejected;
+    int i, n = 0, workers = optiWorkers;
+    rejected = (int *)malloc(sizeof(int) * (size_t)(s->count > 0 ? s->count : 1));
+    if (rejected == NULL)
+        return;
+    for (i = 0; i < s->count; i++) {
+        if (!s->accepted[i])
+            rejected[n++] = i;
+    }
+    if (workers == 0)
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers > MAX_OPTI_WORKERS)
+        workers = MAX_OPTI_WORKERS;
+    if (optiDays > 0 || workers <= 1 || n < OPTI_PARALLEL_MIN ||
+        !opti_parallel(s, rejected, n, workers))
+        opti_run(s, rejected, n);
+    free(rejected);
+}
+
+/* 確保持有者清單至少還能加入一筆，記憶體不足回傳 0 */
+static int holder_reserve(HolderList *h) {
+    if (h->count == h->capacity) {
+        int newCapacity = h->capacity ? h->capacity * 2 : 16;
+        int *grown = (int *)realloc(h->items, sizeof(int) * (size_t)newCapacity);
+        if (grown == NULL)
+            return 0;
+        h->items = grown;
+        h->capacity = newCapacity;
+    }
+    return 1;
+}
+
+/* 將預約加入某資源某優先權的持有者清單 */
+static int holder_push(HolderList *h, int index) {
+    if (!holder_reserve(h))
+        return 0;
+    h->items[h->count++] = index;
+    return 1;
+}
+
+/* 移除持有者清單中已被逐出的預約 */
+static void holder_compact(const Schedule *s, HolderList *h) {
+    int k, j;
+    for (k = 0, j = 0; k < h->count; k++) {
+        if (s->accepted[h->items[k]])
+            h->items[j++] = h->items[k];
+    }
+    h->count = j;
+}
+
+/* 將預約計入或移出 PRIO 的當日佔用（移出時持有者清單留待掃描時清理） */
+static void prio_occupy(PrioDay *day, const Booking *b, int add) {
+    int start, end;
+    booking_slots(b, &start, &end);
+    if (add)
+        day_add_slots(&day->occ, b, start, end);
+    else
+        day_remove_slots(&day->occ, b, start, end);
+}
+
+/* 收錄 PRIO 中的一筆預約：若資源不足，找出需要騰出的時段（各資源在預約時段內已滿的部分），
+   每次在優先權較低的持有者中選出覆蓋最多不足時段者逐出（同分時取優先權最低、到達最早者），
+   直到可容納為止；若無法騰出足夠資源則復原已逐出的預約並拒絕新預約。
+   選擇期間持有者清單不作清理，復原的預約因此仍在清單中，之後仍可被逐出。回傳是否接受 */
+int prio_admit(Schedule *s, int index, PrioDay *day) {
+    const Booking *b = booking_at(index);
+    int res[1 + 3], nres = 0;       /* 所需資源（PRIO_RESOURCES 編號） */
+    SlotSet need[1 + 3], range, other;
+    int *evicted = NULL, nEvicted = 0, capEvicted = 0;
+    int start, end, r, q, k, w, j, score, best, bestScore, bestLevel, deficit, ok = 1;
+    unsigned int mask;
+
+    booking_slots(b, &start, &end);
+    range = slot_range(start, end);
+    if (b->requires_parking)
+        res[nres++] = 0;
+    for (mask = b->essentials, k = 0; mask != 0; mask >>= 1, k++) {
+        if (mask & 1u)
+            res[nres++] = 1 + k;
+    }
+    /* 先為新預約預留清單空間，接受後加入清單不會失敗 */
+    for (r = 0; r < nres; r++) {
+        if (!holder_reserve(&day->holders[res[r]][get_priority(b)]))
+            return 0;
+    }
+    for (;;) {
+        deficit = 0;
+        for (r = 0; r < nres; r++) {
+            const SlotSet *top = res[r] == 0 ? &day->occ.parking[PARKING_CAPACITY - 1]
+                                             : &day->occ.device[res[r] - 1][ESSENTIAL_CAPACITY - 1];
+            for (w = 0; w < SLOT_WORDS; w++) {
+                need[r].w[w] = top->w[w] & range.w[w];
+                deficit |= need[r].w[w] != 0;
+            }
+        }
+        if (!deficit)
+            break;
+        best = -1;
+        bestScore = 0;
+        bestLevel = 0;
+        for (r = 0; r < nres; r++) {
+            for (q = 0; q < get_priority(b); q++) {
+                const HolderList *h = &day->holders[res[r]][q];
+                for (k = 0; k < h->count; k++) {
+                    int cand = h->items[k];
+                    const Booking *c;
+                    int cs, ce, rr;
+                    if (!s->accepted[cand] || cand == best)
+                        continue;
+                    c = booking_at(cand);
+                    booking_slots(c, &cs, &ce);
+                    other = slot_range(cs, ce);
+                    score = 0;
+                    for (rr = 0; rr < nres; rr++) {
+                        if (res[rr] == 0 ? !c->requires_parking : !essential_requested(c, res[rr] - 1))
+                            continue;
+                        for (w = 0; w < SLOT_WORDS; w++)
+                            score += __builtin_popcountll(other.w[w] & need[rr].w[w]);
+                    }
+                    if (score > bestScore ||
+                        (score == bestScore && score > 0 &&
+                         (q < bestLevel || (q == bestLevel && cand < best)))) {
+                        best = cand;
+                        bestScore = score;
+                        bestLevel = q;
+                    }
+                }
+            }
+        }
+        if (best < 0) {
+            ok = 0;
+            break;
+        }
+        if (nEvicted == capEvicted) {
+            int *grown;
+            capEvicted = capEvicted ? capEvicted * 2 : 8;
+            grown = (int *)realloc(evicted, sizeof(int) * (size_t)capEvicted);
+            if (grown == NULL) {
+                ok = 0;
+                break;
+            }
+            evicted = grown;
+        }
+        evicted[nEvicted++] = best;
+        s->accepted[best] = 0;
+        prio_occupy(day, booking_at(best), 0);
+    }
+    if (!ok) {  /* 復原：被逐出的預約重新計入（仍在持有者清單中） */
+        while (nEvicted > 0) {
+            j = evicted[--nEvicted];
+            s->accepted[j] = 1;
+            prio_occupy(day, booking_at(j), 1);
+        }
+    }
+    if (nEvicted > 0 || !ok) {  /* 逐出結果已確定，清理掃描過的清單 */
+        for (r = 0; r < nres; r++) {
+            for (q = 0; q < get_priority(b); q++)
+                holder_compact(s, &day->holders[res[r]][q]);
+        }
+    }
+    if (ok) {
+        s->preempted += nEvicted;
+        s->accepted[index] = 1;
+        prio_occupy(day, b, 1);
+        for (r = 0; r < nres; r++)
+            holder_push(&day->holders[res[r]][get_priority(b)], index);
+    }
+    free(evicted);
+    return ok;
+}
+
+/* 模擬 PRIO 調度（搶占機制）：
+   按到達順序處理，資源足夠時直接接受；
+   某資源在預約時段內已滿時，逐出與之重疊且優先權較低的預約，並盡量減少被逐出的數目。
+   各日期的佔用及持有者清單只在模擬期間配置 */
+void simulate_PRIO(Schedule *s) {
+    PrioDay **days;
+    int lo = MAX_DAYS, hi = -1, i, r, q, date;
+    for (i = 0; i < s->count; i++) {
+        s->accepted[i] = 0;
+        date = booking_at(i)->date;
+        if (date < lo) lo = date;
+        if (date > hi) hi = date;
+    }
+    if (hi < lo)
+        return;
+    days = (PrioDay **)calloc((size_t)(hi - lo) + 1, sizeof(PrioDay *));
+    if (days == NULL)
+        return;
+    for (i = 0; i < s->count; i++) {
+        date = booking_at(i)->date - lo;
+        if (days[date] == NULL) {
+            days[date] = (PrioDay *)calloc(1, sizeof(PrioDay));
+            if (days[date] == NULL)
+                continue;
+        }
+        prio_admit(s, i, days[date]);
+    }
+    for (date = 0; date <= hi - lo; date++) {
+        if (days[date] == NULL)
+            continue;
+        for (r = 0; r < PRIO_RESOURCES; r++) {
+            for (q = 0; q < PRIO_LEVELS; q++)
+                free(days[date]->holders[r][q].items);
+        }
+        free(days[date]);
+    }
+    free(days);
+}
+
+/* 將預約索引依日期穩定排序（counting sort），回傳 0 表示記憶體不足 */
+int sort_by_date(int *idx, int n) {
+    int *first, *sorted;
+    int lo = MAX_DAYS, hi = -1, i, date;
+    for (i = 0; i < n; i++) {
+        date = booking_at(idx[i])->date;
+        if (date < lo) lo = date;
+        if (date > hi) hi = date;
+    }
+    if (hi <= lo)
+        return 1;
+    first = (int *)calloc((size_t)(hi - lo) + 2, sizeof(int));
+    sorted = (int *)malloc(sizeof(int) * (size_t)n);
+    if (first == NULL || sorted == NULL) {
+        free(first);
+        free(sorted);
+        return 0;
+    }
+    for (i = 0; i < n; i++)
+        first[booking_at(idx[i])->date - lo + 1]++;
+    for (date = lo; date < hi; date++)
+        first[date - lo + 1] += first[date - lo];
+    for (i = 0; i < n; i++)
+        sorted[first[booking_at(idx[i])->date - lo]++] = idx[i];
+    memcpy(idx, sorted, sizeof(int) * (size_t)n);
+    free(first);
+    free(sorted);
+    return 1;
+}
+
+/* 目前時間（毫秒，CLOCK_MONOTONIC） */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* OPTI_EXACT 的候選位置：choice 為 EXACT_ORIGINAL 時為原定時間，否則為開始時段；
+   回傳預約佔用的時段範圍 [start, end) */
+static void exact_slots(const Booking *b, int choice, int *start, int *end) {
+    if (choice == EXACT_ORIGINAL) {
+        booking_slots(b, start, end);
+        return;
+    }
+    *start = choice;
+    *end = choice + (booking_minutes(b) + SLOT_MINUTES - 1) / SLOT_MINUTES;
+    if (*end > SLOTS_PER_DAY)
+        *end = SLOTS_PER_DAY;
+}
+
+/* 第 k 個候選位置：原定時間，之後為 08:00-20:00 的每個整點；與原定時間相同的整點略過 */
+static int exact_candidate(const Booking *b, int k) {
+    int slot;
+    if (k == 0)
+        return EXACT_ORIGINAL;
+    slot = OPTI_FIRST_SLOT + (k - 1) * (60 / SLOT_MINUTES);
+    if (slot > OPTI_LAST_SLOT)
+        return EXACT_REJECT;
+    return slot == b->start / SLOT_MINUTES && b->start % SLOT_MINUTES == 0 ? EXACT_ORIGINAL : slot;
+}
+
+/* 上界：目前已接受數加上仍能放入某個候選位置的剩餘預約數
+   （佔用在搜尋分支中只增不減，現在放不下的預約之後也放不下） */
+static int exact_bound(ExactSearch *e, int depth, int accepted) {
+    int i, k, c, start, end;
+    for (i = depth; i < e->n; i++) {
+        const Booking *b = booking_at(e->idx[i]);
+        for (k = 0; (c = exact_candidate(b, k)) != EXACT_REJECT; k++) {
+            if (k > 0 && c == EXACT_ORIGINAL)
+                continue;
+            exact_slots(b, c, &start, &end);
+            if (day_fits_slots(&e->occ, b, start, end)) {
+                accepted++;
+                break;
+            }
+        }
+    }
+    return accepted;
+}
+
+/* 深度優先的 branch-and-bound：第 depth 筆預約依序嘗試各候選位置，最後嘗試拒絕；
+   超過時間預算時停止，保留目前最佳解 */
+void exact_search(ExactSearch *e, int depth, int accepted) {
+    const Booking *b;
+    long before = e->nodes;
+    int k, c, start, end;
+    if (e->timedOut)
+        return;
+    /* 不可能勝過目前最佳解的分支先剪除，不必檢查時間 */
+    if (accepted + (e->n - depth) <= e->bestCount)
+        return;
+    /* 每個節點的上界計算與剩餘預約數成正比，大的日期需要較頻繁地檢查時間 */
+    e->nodes += 1 + (e->n - depth);
+    if ((before >> 10) != (e->nodes >> 10) && now_ms() > e->deadline) {
+        e->timedOut = 1;
+        return;
+    }
+    if (depth == e->n) {
+        e->bestCount = accepted;
+        memcpy(e->best, e->choice, sizeof(short) * (size_t)e->n);
+        return;
+    }
+    if (exact_bound(e, depth, accepted) <= e->bestCount)
+        return;
+    b = booking_at(e->idx[depth]);
+    for (k = 0; (c = exact_candidate(b, k)) != EXACT_REJECT; k++) {
+        if (k > 0 && c == EXACT_ORIGINAL)
+            continue;
+        exact_slots(b, c, &start, &end);
+        if (!day_fits_slots(&e->occ, b, start, end))
+            continue;
+        day_add_slots(&e->occ, b, start, end);
+        e->choice[depth] = (short)c;
+        exact_search(e, depth + 1, accepted + 1);
+        day_remove_slots(&e->occ, b, start, end);
+        if (e->timedOut)
+            return;
+    }
+    e->choice[depth] = EXACT_REJECT;
+    exact_search(e, depth + 1, accepted);
+}
+
+/* 以 OPTI 啟發式（原定時間先到先得，再為被拒者找最早時段）作為一個日期的初始解 */
+static void exact_seed(ExactSearch *e) {
+    int i, start, end;
+    memset(&e->occ, 0, sizeof(e->occ));
+    e->bestCount = 0;
+    for (i = 0; i < e->n; i++) {
+        const Booking *b = booking_at(e->idx[i]);
+        booking_slots(b, &start, &end);
+        e->best[i] = EXACT_REJECT;
+        if (day_fits_slots(&e->occ, b, start, end)) {
+            day_add_slots(&e->occ, b, start, end);
+            e->best[i] = EXACT_ORIGINAL;
+            e->bestCount++;
+        }
+    }
+    for (i = 0; i < e->n; i++) {
+        const Booking *b = booking_at(e->idx[i]);
+        int slot;
+        if (e->best[i] != EXACT_REJECT)
+            continue;
+        slot = earliest_fit(&e->occ, b, (booking_minutes(b) + SLOT_MINUTES - 1) / SLOT_MINUTES);
+        if (slot >= 0) {
+            exact_slots(b, slot, &start, &end);
+            day_add_slots(&e->occ, b, start, end);
+            e->best[i] = (short)slot;
+            e->bestCount++;
+        }
+    }
+    memset(&e->occ, 0, sizeof(e->occ));
+}
+
+/* 模擬 OPTI_EXACT：逐日以 branch-and-bound 求接受預約數最多的排程，每筆預約可維持原定時間、
+   移到 08:00-20:00 的任一整點或被拒絕。以 OPTI 啟發式結果為初始解，
+   時間預算為每筆 FCFS 拒絕的預約 EXACT_MS_PER_REJECTED 毫秒（不超過 exactBudgetMs），
+   平均分配給尚未處理的日期，用完時保留目前最佳解。「最佳」只就上述候選時間而言 */
+void simulate_OPTI_EXACT(Schedule *s) {
+    ExactSearch e;
+    int *order;
+    int i, j, k, days = 0, date, rejected = 0;
+    double start = now_ms(), budget;
+    order = (int *)malloc(sizeof(int) * (size_t)(s->count > 0 ? s->count : 1));
+    e.choice = (short *)malloc(sizeof(short) * (size_t)(s->count > 0 ? s->count : 1));
+    e.best = (short *)malloc(sizeof(short) * (size_t)(s->count > 0 ? s->count : 1));
+    if (order == NULL || e.choice == NULL || e.best == NULL) {
+        free(order);
+        free(e.choice);
+        free(e.best);
+        return;
+    }
+    for (i = 0; i < s->count; i++)
+        order[i] = i;
+    if (!sort_by_date(order, s->count)) {
+        free(order);
+        free(e.choice);
+        free(e.best);
+        return;
+    }
+    for (i = 0; i < s->count; i = j) {
+        for (j = i; j < s->count && booking_at(order[j])->date == booking_at(order[i])->date; j++)
+            ;
+        days++;
+    }
+    for (i = 0; i < s->count; i++)
+        rejected += !s->accepted[i];
+    budget = (double)rejected * EXACT_MS_PER_REJECTED;
+    if (budget > exactBudgetMs)
+        budget = exactBudgetMs;
+    s->search = 1;
+    for (i = 0; i < s->count; i = j) {
+        date = booking_at(order[i])->date;
+        for (j = i; j < s->count && booking_at(order[j])->date == date; j++)
+            ;
+        e.idx = order + i;
+        e.n = j - i;
+        e.nodes = 0;
+        e.timedOut = 0;
+        e.deadline = now_ms() + (start + budget - now_ms()) / days--;
+        exact_seed(&e);
+        if (e.bestCount < e.n)  /* 初始解已接受全部預約時即為最佳，不需搜尋 */
+            exact_search(&e, 0, 0);
+        if (e.timedOut)
+            s->search = 2;
+        for (k = 0; k < e.n; k++) {
+            s->accepted[e.idx[k]] = e.best[k] != EXACT_REJECT;
+            s->startSlot[e.idx[k]] = e.best[k] >= 0 ? e.best[k] : -1;
+        }
+    }
+    free(order);
+    free(e.choice);
+    free(e.best);
+}
+
+/* 以下為使用者命令處理函式 */
+
+/* 以空白、tab 或 ';' 切分 [line, end) 為欄位，欄位直接指向原緩衝區，不複製字串 */
+int split_fields(const char *line, const char *end, Field *fields, int maxFields) {
+    int n = 0;
+    const char *p = line;
+    while (p < end && n < maxFields) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ';' || *p == '\r' || *p == '\n'))
+            p++;
+        if (p >= end)
+            break;
+        fields[n].text = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != ';' && *p != '\r' && *p != '\n')
+            p++;
+        fields[n].len = (int)(p - fields[n].text);
+        n++;
+    }
+    return n;
+}
+
+/* 比較欄位是否等於某字串 */
+static int field_is(const Field *f, const char *word) {
+    return (int)strlen(word) == f->len && strncmp(f->text, word, (size_t)f->len) == 0;
+}
+
+/* 由命令名稱取得預約類型，非新增預約的命令回傳 -1 */
+int command_type(const Field *f) {
+    if (field_is(f, "addParking"))
+        return TYPE_PARKING;
+    if (field_is(f, "addReservation"))
+        return TYPE_RESERVATION;
+    if (field_is(f, "addEvent"))
+        return TYPE_EVENT;
+    if (field_is(f, "bookEssentials"))
+        return TYPE_ESSENTIALS;
+    return -1;
+}
+
+/* 由欄位（會員、日期、時間、時長及設備）建立預約，名稱在此轉為 id；
+   欄位不足或格式錯誤時回傳 0 並以 error 說明原因 */
+int parse_booking(const Field *fields, int count, int type, Booking *b, const char **error) {
+    static const int maxDevices[] = { 1, 2, 2, 3 };  /* 依 TYPE_* 可指定的設備數目 */
+    const char *member;
+    int memberLen, k, id;
+    memset(b, 0, sizeof(*b));
+    b->device[0] = b->device[1] = b->device[2] = NO_DEVICE;
+    if (count < 4) {
+        *error = "missing fields (expected -member date time duration)";
+        return 0;
+    }
+    member = fields[0].text;
+    memberLen = fields[0].len;
+    if (memberLen > 0 && member[0] == '-') {
+        member++;
+        memberLen--;
+    } else if (memberLen > 2 && (unsigned char)member[0] == 0xE2 &&
+               (unsigned char)member[1] == 0x80 && (unsigned char)member[2] == 0x93) {
+        member += 3;
+        memberLen -= 3;
+    }
+    if (memberLen == 0) {
+        *error = "invalid member";
+        return 0;
+    }
+    if (memberLen > MAX_NAME_LENGTH) {
+        *error = "member name too long";
+        return 0;
+    }
+    b->start = (short)parse_time(fields[2].text, fields[2].len);
+    if (b->start < 0) {
+        *error = "invalid time (expected hh:mm)";
+        return 0;
+    }
+    if (!parse_duration(fields[3].text, fields[3].len, &b->duration)) {
+        *error = "invalid duration";
+        return 0;
+    }
+    b->date = parse_date(fields[1].text, fields[1].len);
+    if (b->date < 0) {
+        *error = "invalid date (expected YYYY-MM-DD)";
+        return 0;
+    }
+    for (k = 0; k < maxDevices[type] && 4 + k < count; k++) {
+        if (fields[4 + k].len > MAX_NAME_LENGTH) {
+            *error = "device name too long";
+            return 0;
+        }
+    }
+    for (k = 0; k < maxDevices[type] && 4 + k < count; k++) {
+        id = name_intern(&deviceTable, fields[4 + k].text, (size_t)fields[4 + k].len);
+        if (id < 0) {
+            *error = "too many device types";
+            return 0;
+        }
+        b->device[k] = (unsigned char)id;
+        b->essentials |= 1u << id;
+    }
+    /* 會員最後才登錄，格式錯誤的行不會留下會員名稱（及其日誌記錄） */
+    b->member = name_intern(&memberTable, member, (size_t)memberLen);
+    if (b->member < 0) {
+        *error = "out of memory";
+        return 0;
+    }
+    b->type = (unsigned char)type;
+    b->requires_parking = (type != TYPE_ESSENTIALS);
+    return 1;
+}
+
+/* 新增預約命令的共同處理：解析整行後交由 FCFS 收錄 */
+void process_add(char *line, int type) {
+    Field fields[MAX_FIELDS];
+    Booking b;
+    const char *error;
+    int n = split_fields(line, line + strlen(line), fields, MAX_FIELDS);
+    if (!parse_booking(fields + 1, n - 1, type, &b, &error)) {
+        printf("Error: %s\n", error);
+        return;
+    }
+    if (admit_booking(&b))
+        printf("-> [Pending]\n");
+}
+
+/* addParking -member_X YYYY-MM-DD hh:mm duration [essential1 essential2]; */
+void process_addParking(char *line) {
+    process_add(line, TYPE_PARKING);
+}
+
+/* addReservation -member_X YYYY-MM-DD hh:mm duration essential1 essential2; */
+void process_addReservation(char *line) {
+    process_add(line, TYPE_RESERVATION);
+}
+
+/* addEvent -member_X YYYY-MM-DD hh:mm duration essential1 essential2 essential3; */
+void process_addEvent(char *line) {
+    process_add(line, TYPE_EVENT);
+}
+
+/* bookEssentials -member_X YYYY-MM-DD hh:mm duration essential; */
+void process_bookEssentials(char *line) {
+    process_add(line, TYPE_ESSENTIALS);
+}
+
+/* 以 mmap 讀入批次檔，新增預約的行直接由映射記憶體解析，其餘命令交由 process_command；
+   格式錯誤的行會連同行號報告。bulk 不為 NULL 時預約先暫存，於其他命令前及檔案結尾
+   一次收錄；pool 不為 NULL 時預約交由各日期的分片執行緒收錄。無法開啟檔案時回傳 0 */
+int load_batch(const char *path, BulkBatch *bulk, ShardPool *pool) {
+    Field fields[MAX_FIELDS];
+    char command[MAX_LINE_LENGTH];
+    struct stat st;
+    const char *data, *p, *end, *lineEnd;
+    const char *error;
+    Booking b;
+    int fd, n, type, lineNo = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return 0;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 1;
+    }
+    data = (const char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == (const char *)MAP_FAILED)
+        return 0;
+    madvise((void *)data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    end = data + st.st_size;
+    if (pool != NULL) {  /* 每行最多一筆預約，依行數一次配置，分片執行緒讀取期間不會搬移 */
+        for (p = data, n = 1; (p = (const char *)memchr(p, '\n', (size_t)(end - p))) != NULL; p++)
+            n++;
+        pool->pending = (Booking *)malloc(sizeof(Booking) * (size_t)n);
+        if (pool->pending == NULL) {
+            munmap((void *)data, (size_t)st.st_size);
+            printf("Error: Out of memory\n");
+            return 1;
+        }
+        pool->capacity = n;
+        pool->count = 0;
+    }
+    for (p = data; p < end && !endRequested; p = lineEnd + 1) {
+        lineEnd = (const char *)memchr(p, '\n', (size_t)(end - p));
+        if (lineEnd == NULL)
+            lineEnd = end;
+        lineNo++;
+        n = split_fields(p, lineEnd, fields, MAX_FIELDS);
+        if (n == 0)
+            continue;
+        type = command_type(&fields[0]);
+        if (lineEnd - p >= MAX_LINE_LENGTH) {  /* 與互動輸入的行長度限制相同 */
+            printf("Error: %s line %d: line too long\n", path, lineNo);
+        } else if (type >= 0) {
+            if (!parse_booking(fields + 1, n - 1, type, &b, &error))
+                printf("Error: %s line %d: %s\n", path, lineNo, error);
+            else if (bulk != NULL)
+                bulk_push(bulk, &b);
+            else if (pool != NULL)
+                shard_push(pool, &b);
+            else if (admit_booking(&b))
+                printf("-> [Pending]\n");
+        } else {
+            if (bulk != NULL)
+                bulk_admit(bulk);  /* 其他命令（如報告）須看到之前的預約 */
+            if (pool != NULL)
+                shard_drain(pool);
+            memcpy(command, p, (size_t)(lineEnd - p));
+            command[lineEnd - p] = '\0';
+            command[strcspn(command, "\r")] = '\0';
+            process_command(command);
+        }
+    }
+    munmap((void *)data, (size_t)st.st_size);
+    if (bulk != NULL)
+        bulk_admit(bulk);
+    if (pool != NULL) {
+        shard_drain(pool);
+        free(pool->pending);
+        pool->pending = NULL;
+    }
+    return 1;
+}
+
+/* 分片執行緒：依序取出佇列中的預約，以該日期的佔用索引決定是否接受 */
+static void *shard_main(void *arg) {
+    Shard *shard = (Shard *)arg;
+    Booking *b;
+    DayOccupancy *day;
+    int seq;
+    for (;;) {
+        pthread_mutex_lock(&shard->lock);
+        while (shard->count == 0 && !shard->closing)
+            pthread_cond_wait(&shard->notEmpty, &shard->lock);
+        if (shard->count == 0) {
+            pthread_mutex_unlock(&shard->lock);
+            return NULL;
+        }
+        seq = shard->items[shard->head];
+        shard->head = (shard->head + 1) % SHARD_QUEUE_SIZE;
+        shard->count--;
+        shard->busy = 1;
+        pthread_cond_signal(&shard->notFull);
+        pthread_mutex_unlock(&shard->lock);
+
+        b = &shard->pool->pending[seq];
+        day = day_occupancy(b->date, 1);
+        b->accepted = (day == NULL || day_fits(day, b)) ? 1 : 0;
+        if (b->accepted && day != NULL)
+            day_add(day, b);
+
+        pthread_mutex_lock(&shard->lock);
+        shard->busy = 0;
+        if (shard->count == 0)
+            pthread_cond_signal(&shard->drained);
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/* 建立 shards 個分片執行緒；失敗時停止已建立的執行緒並回傳 0 */
+int shard_start(ShardPool *pool, int shards) {
+    int k;
+    memset(pool, 0, sizeof(*pool));
+    for (k = 0; k < shards; k++) {
+        Shard *shard = &pool->shards[k];
+        shard->pool = pool;
+        pthread_mutex_init(&shard->lock, NULL);
+        pthread_cond_init(&shard->notEmpty, NULL);
+        pthread_cond_init(&shard->notFull, NULL);
+        pthread_cond_init(&shard->drained, NULL);
+        if (pthread_create(&shard->thread, NULL, shard_main, shard) != 0) {
+            pthread_mutex_destroy(&shard->lock);
+            pthread_cond_destroy(&shard->notEmpty);
+            pthread_cond_destroy(&shard->notFull);
+            pthread_cond_destroy(&shard->drained);
+            shard_stop(pool);
+            return 0;
+        }
+        pool->shardCount++;
+    }
+    return 1;
+}
+
+/* 將解析好的預約交給擁有其日期的分片；佇列已滿時等待 */
+void shard_push(ShardPool *pool, const Booking *b) {
+    Shard *shard = &pool->shards[b->date % pool->shardCount];
+    int seq = pool->count++;
+    pool->pending[seq] = *b;
+    pthread_mutex_lock(&shard->lock);
+    while (shard->count == SHARD_QUEUE_SIZE)
+        pthread_cond_wait(&shard->notFull, &shard->lock);
+    shard->items[(shard->head + shard->count) % SHARD_QUEUE_SIZE] = seq;
+    shard->count++;
+    pthread_cond_signal(&shard->notEmpty);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/* 等待所有分片處理完佇列，再依到達順序把決定存入儲存區 */
+void shard_drain(ShardPool *pool) {
+    int k, i;
+    for (k = 0; k < pool->shardCount; k++) {
+        Shard *shard = &pool->shards[k];
+        pthread_mutex_lock(&shard->lock);
+        while (shard->count > 0 || shard->busy)
+            pthread_cond_wait(&shard->drained, &shard->lock);
+        pthread_mutex_unlock(&shard->lock);
+    }
+    for (i = 0; i < pool->count; i++) {
+        if (store_append(&pool->pending[i]) == NULL) {
+            printf("Error: Booking store is full\n");
+            break;
+        }
+        stats_add(&fcfsStats, &pool->pending[i]);
+        pool->accepted += pool->pending[i].accepted;
+        pool->total++;
+    }
+    pool->count = 0;
+    store_publish();
+}
+
+/* 通知分片執行緒結束並等待 */
+void shard_stop(ShardPool *pool) {
+    int k;
+    for (k = 0; k < pool->shardCount; k++) {
+        Shard *shard = &pool->shards[k];
+        pthread_mutex_lock(&shard->lock);
+        shard->closing = 1;
+        pthread_cond_signal(&shard->notEmpty);
+        pthread_mutex_unlock(&shard->lock);
+        pthread_join(shard->thread, NULL);
+        pthread_mutex_destroy(&shard->lock);
+        pthread_cond_destroy(&shard->notEmpty);
+        pthread_cond_destroy(&shard->notFull);
+        pthread_cond_destroy(&shard->drained);
+    }
+    pool->shardCount = 0;
+}
+
+/* 暫存一筆待收錄的預約；記憶體不足時回傳 0 */
+int bulk_push(BulkBatch *bulk, const Booking *b) {
+    if (bulk->count == bulk->capacity) {
+        int newCapacity = bulk->capacity ? bulk->capacity * 2 : 1024;
+        Booking *grown = (Booking *)realloc(bulk->items, sizeof(Booking) * (size_t)newCapacity);
+        if (grown == NULL) {
+            printf("Error: Out of memory\n");
+            return 0;
+        }
+        bulk->items = grown;
+        bulk->capacity = newCapacity;
+    }
+    bulk->items[bulk->count++] = *b;
+    return 1;
+}
+
+/* 一次收錄暫存的預約：先依日期穩定分組（counting sort），每個日期只取一次佔用計數，
+   依到達順序逐筆檢查並累加，再按原順序存入儲存區。不同日期互不影響，
+   因此結果與逐筆 admit_booking 相同。回傳收錄筆數 */
+int bulk_admit(BulkBatch *bulk) {
+    int *first, *order;
+    int n = bulk->count, lo = MAX_DAYS, hi = -1, dates, i, j, date;
+    DayOccupancy *day;
+    Booking *b;
+    if (n == 0)
+        return 0;
+    if (n > MAX_CHUNKS * CHUNK_SIZE - store.count) {
+        printf("Error: Booking store is full\n");
+        bulk->count = 0;
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        if (bulk->items[i].date < lo) lo = bulk->items[i].date;
+        if (bulk->items[i].date > hi) hi = bulk->items[i].date;
+    }
+    if (hi < lo)
+        return 0;
+    dates = hi - lo + 1;
+    first = (int *)calloc((size_t)dates + 1, sizeof(int));
+    order = (int *)malloc(sizeof(int) * (size_t)n);
+    if (first == NULL || order == NULL) {
+        free(first);
+        free(order);
+        printf("Error: Out of memory\n");
+        bulk->count = 0;
+        return 0;
+    }
+    for (i = 0; i < n; i++)
+        first[bulk->items[i].date - lo + 1]++;
+    for (date = 0; date < dates; date++)
+        first[date + 1] += first[date];
+    for (i = 0; i < n; i++)
+        order[first[bulk->items[i].date - lo]++] = i;
+
+    for (i = 0; i < n; i = j) {
+        date = bulk->items[order[i]].date;
+        day = day_occupancy(date, 1);
+        for (j = i; j < n && bulk->items[order[j]].date == date; j++) {
+            b = &bulk->items[order[j]];
+            b->accepted = (day == NULL || day_fits(day, b)) ? 1 : 0;
+            if (b->accepted && day != NULL)
+                day_add(day, b);
+        }
+    }
+    for (i = 0; i < n; i++) {
+        b = &bulk->items[i];
+        store_append(b);
+        stats_add(&fcfsStats, b);
+        bulk->accepted += b->accepted;
+    }
+    store_publish();
+    free(first);
+    free(order);
+    bulk->total += n;
+    bulk->count = 0;
+    return n;
+}
+
+/* addBatch -batchfile [-bulk | -shards N] */
+void process_addBatch(char *line) {
+    BulkBatch bulk = { NULL, 0, 0, 0, 0 };
+    ShardPool *pool;
+    char *token, *option, *value;
+    int ok, shards;
+    token = strtok(NULL, " ;\n");
     if (token == NULL) return;
-    b.duration = (float)atof(token);
-    token = strtok(NULL, " ");
+    if (token[0] == '-' || (unsigned char)token[0] == 0xE2)
+        token++;  /* Skip leading dash */
+    option = strtok(NULL, " ;\n");
+    if (option != NULL && strcmp(normalize_member(option), "bulk") == 0) {
+        ok = load_batch(token, &bulk, NULL);
+        free(bulk.items);
+        if (ok) {
+            printf("-> [Pending] %d bookings (%d accepted, %d rejected)\n",
+                   bulk.total, bulk.accepted, bulk.total - bulk.accepted);
+            return;
+        }
+    } else if (option != NULL && strcmp(normalize_member(option), "shards") == 0) {
+        value = strtok(NULL, " ;\n");
+        shards = value != NULL ? atoi(value) : 0;
+        if (shards < 1 || shards > MAX_SHARDS) {
+            printf("Error: shards must be 1-%d\n", MAX_SHARDS);
+            return;
+        }
+        /* 每次呼叫各自配置：批次檔中的 addBatch -shards 會在外層分片執行緒仍存在時重入 */
+        pool = (ShardPool *)malloc(sizeof(ShardPool));
+        if (pool == NULL) {
+            printf("Error: Out of memory\n");
+            return;
+        }
+        if (!shard_start(pool, shards)) {
+            free(pool);
+            printf("Error: Cannot start shard threads\n");
+            return;
+        }
+        ok = load_batch(token, NULL, pool);
+        shard_stop(pool);
+        if (ok) {
+            printf("-> [Pending] %d bookings (%d accepted, %d rejected)\n",
+                   pool->total, pool->accepted, pool->total - pool->accepted);
+            free(pool);
+            return;
+        }
+        free(pool);
+    } else {
+        ok = load_batch(token, NULL, NULL);
+    }
+    if (!ok) {
+        printf("Error: Cannot open batch file %s\n", token);
+        return;
+    }
+    printf("-> [Pending]\n");
+}
+
+static int cmp_member_name(const void *a, const void *b) {
+    return strcmp(memberTable.names[*(const int *)a], memberTable.names[*(const int *)b]);
+}
+
+/* 依名稱排序全部會員，會員數未變時沿用上次結果；記憶體不足回傳 0 */
+static int member_order_update(void) {
+    int m = memberTable.count;
+    int *order, *rank;
+    int r;
+    if (m == memberOrderCount)
+        return 1;
+    order = (int *)realloc(memberOrder, sizeof(int) * (size_t)(m > 0 ? m : 1));
+    if (order == NULL)
+        return 0;
+    memberOrder = order;
+    rank = (int *)realloc(memberRank, sizeof(int) * (size_t)(m > 0 ? m : 1));
+    if (rank == NULL)
+        return 0;
+    memberRank = rank;
+    for (r = 0; r < m; r++)
+        memberOrder[r] = r;
+    qsort(memberOrder, (size_t)m, sizeof(int), cmp_member_name);
+    for (r = 0; r < m; r++)
+        memberRank[memberOrder[r]] = r;
+    memberOrderCount = m;
+    return 1;
+}
+
+/* 分組鍵：先接受後拒絕，再依會員名次；byPriority 時同一會員內優先權高者在前 */
+static int group_key(const Schedule *s, int i, int byPriority) {
+    const Booking *b = booking_at(i);
+    int key = (s->accepted[i] ? 0 : memberOrderCount) + memberRank[b->member];
+    if (!byPriority)
+        return key;
+    return key * PRIO_LEVELS + PRIO_LEVELS - 1 - get_priority(b);
+}
+
+/* 以一次計數排序將排程中的預約依會員分組（見 MemberGroups），同組內保持到達順序，
+   取代逐一會員掃描全部預約再 qsort；order 需可容納 s->count 個索引，
+   記憶體不足回傳 0。g->first 由呼叫者釋放 */
+int group_by_member(const Schedule *s, int byPriority, int *order, MemberGroups *g) {
+    int levels = byPriority ? PRIO_LEVELS : 1;
+    int keys, i, key;
+    int *next;
+    if (!member_order_update())
+        return 0;
+    keys = 2 * memberOrderCount * levels;
+    next = (int *)calloc((size_t)keys + 1, sizeof(int));
+    g->first = (int *)malloc(sizeof(int) * (size_t)(2 * memberOrderCount + 1));
+    if (next == NULL || g->first == NULL) {
+        free(next);
+        free(g->first);
+        return 0;
+    }
+    for (i = 0; i < s->count; i++)
+        next[group_key(s, i, byPriority) + 1]++;
+    for (key = 0; key < keys; key++)
+        next[key + 1] += next[key];
+    for (i = 0; i <= 2 * memberOrderCount; i++)
+        g->first[i] = next[i * levels];
+    for (i = 0; i < s->count; i++)
+        order[next[group_key(s, i, byPriority)]++] = i;
+    free(next);
+    g->memberCount = memberOrderCount;
+    g->members = memberOrder;
+    return 1;
+}
+
+/* 輸出預約記錄（依 FCFS 或 PRIO 模式排序） */
+void process_printBookings(char *line) {
+    char *token;
+    char outBuffer[1024];
+    int i;
+    char algorithm[10];
+    const Schedule *sched;
+    const ScheduleCache *cache;
+    Snapshot snap;
+    double outputStart;
+    int *memberIdx;
+    MemberGroups groups;
+
+    // 讀取使用者指定模式 (-fcfs 或 -prio)
+    token = strtok(line, " ");
+    token = strtok(NULL, " ;\n");  /* 預期為 "-fcfs" 或 "-prio" */
     if (token != NULL) {
-        strcpy(b.essential1, token);
-        token = strtok(NULL, " ");
-        if (token != NULL) {
-            strcpy(b.essential2, token);
-            token = strtok(NULL, " ;\n");
-            if (token != NULL)
-                strcpy(b.essential3, token);
+        token = normalize_member(token);
+        if (strcmp(token, "PRIO") == 0 || strcmp(token, "prio") == 0)
+            strcpy(algorithm, "PRIO");
+        else
+            strcpy(algorithm, "FCFS");
+    } else {
+        strcpy(algorithm, "FCFS");
+    }
+
+    // 根據模式取得要印出的排程（FCFS 模式直接使用全局預約記錄的接受狀態，
+    // PRIO 模式重用上次的模擬結果或重新模擬優先調度）
+    snapshot_take(&snap);
+    if (strcmp(algorithm, "PRIO") == 0)
+        cache = cached_schedule(&prioCache, simulate_PRIO, &snap);
+    else
+        cache = cached_schedule(&fcfsCache, NULL, &snap);
+    memberIdx = (int *)malloc(sizeof(int) * (size_t)(snap.count > 0 ? snap.count : 1));
+    if (memberIdx == NULL || cache == NULL ||
+        !group_by_member(&cache->sched, strcmp(algorithm, "PRIO") == 0, memberIdx, &groups)) {
+        free(memberIdx);
+        printf("Error: Out of memory\n");
+        return;
+    }
+    sched = &cache->sched;
+    
+    outputStart = now_ms();
+    sprintf(outBuffer, "\n** Parking Booking – ACCEPTED / %s **\n", algorithm);
+    report_append(&report, outBuffer, strlen(outBuffer));
+
+    // 處理已接受的預約
+    {
+        int foundAnyAccepted = 0;
+        int k;
+        for (i = 0; i < groups.memberCount; i++) {
+            const char *member = memberTable.names[groups.members[i]];
+            int *group = memberIdx + groups.first[i];
+            int count = groups.first[i + 1] - groups.first[i];
+            int memberCount = count;
+
+            if (count > 0) {
+                foundAnyAccepted = 1;
+                snprintf(outBuffer, sizeof(outBuffer), "%s has the following bookings:\n", member);
+                report_append(&report, outBuffer, strlen(outBuffer));
+                sprintf(outBuffer, "Date       Start End   Type         Device\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+                sprintf(outBuffer, "===========================================================================\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+
+                for (k = 0; k < memberCount; k++) {
+                    Booking *bk = booking_at(group[k]);
+                    char dateStr[16], startTime[16], endTime[16];
+                    schedule_times(sched, group[k], startTime, endTime);
+
+                    char typeStr[20];
+                    snprintf(typeStr, sizeof(typeStr), "%s",
+                             bk->type == TYPE_ESSENTIALS ? "*" : typeNames[bk->type]);
+
+                    char deviceStr[100];
+                    device_list(bk, 2, "*", deviceStr, sizeof(deviceStr));
+
+                    char bookingLine[256];
+                    snprintf(bookingLine, sizeof(bookingLine), "%-10s %-5s %-5s %-12s %s\n",
+                            format_date(schedule_date(sched, group[k]), dateStr),
+                            startTime,
+                            endTime,
+                            typeStr,
+                            deviceStr);
+                    report_append(&report, bookingLine, strlen(bookingLine));
+                }
+                sprintf(outBuffer, "\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+            }
+        }
+
+        if (foundAnyAccepted) {
+            sprintf(outBuffer, "- End -\n");
+            report_append(&report, outBuffer, strlen(outBuffer));
+        } else {
+            sprintf(outBuffer, "No accepted bookings.\n");
+            report_append(&report, outBuffer, strlen(outBuffer));
+        }
+
+        sprintf(outBuffer, "===========================================================================\n");
+        report_append(&report, outBuffer, strlen(outBuffer));
+    }
+
+    // 輸出拒絕的預約
+    sprintf(outBuffer, "\n** Parking Booking – REJECTED / %s **\n", algorithm);
+    report_append(&report, outBuffer, strlen(outBuffer));
+
+    {
+        int foundAnyRejected = 0;
+        int k;
+        for (i = 0; i < groups.memberCount; i++) {
+            const char *member = memberTable.names[groups.members[i]];
+            int *group = memberIdx + groups.first[groups.memberCount + i];
+            int count = groups.first[groups.memberCount + i + 1] - groups.first[groups.memberCount + i];
+            int memberCount = count;
+
+            if (count > 0) {
+                foundAnyRejected = 1;
+                snprintf(outBuffer, sizeof(outBuffer), "%s (there are %d bookings rejected):\n", member, count);
+                report_append(&report, outBuffer, strlen(outBuffer));
+                sprintf(outBuffer, "Date       Start End   Type         Essentials\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+                sprintf(outBuffer, "===========================================================================\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+
+                for (k = 0; k < memberCount; k++) {
+                    Booking *bk = booking_at(group[k]);
+                    char dateStr[16], startTime[16], endTime[16];
+                    schedule_times(sched, group[k], startTime, endTime);
+
+                    char typeStr[20];
+                    snprintf(typeStr, sizeof(typeStr), "%s", typeNames[bk->type]);
+
+                    char essStr[100];
+                    device_list(bk, 2, "-", essStr, sizeof(essStr));
+
+                    char bookingLine[256];
+                    snprintf(bookingLine, sizeof(bookingLine), "%-10s %-5s %-5s %-12s %s\n",
+                            format_date(schedule_date(sched, group[k]), dateStr),
+                            startTime,
+                            endTime,
+                            typeStr,
+                            essStr);
+                    report_append(&report, bookingLine, strlen(bookingLine));
+                }
+                sprintf(outBuffer, "\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+            }
+        }
+
+        if (foundAnyRejected) {
+            sprintf(outBuffer, "- End -\n");
+            report_append(&report, outBuffer, strlen(outBuffer));
+        } else {
+            sprintf(outBuffer, "No rejected bookings.\n");
+            report_append(&report, outBuffer, strlen(outBuffer));
+        }
+        sprintf(outBuffer, "===========================================================================\n");
+        report_append(&report, outBuffer, strlen(outBuffer));
+    }
+
+    report_send(&report);
+    latency_record(STAT_REPORT_OUTPUT, outputStart);
+    free(memberIdx);
+    free(groups.first);
+    printf("-> [Done!]\n");
+}
+
+/* 統計模擬排程的結果（s 為 NULL 時使用 FCFS 的接受狀態），逐個 chunk 掃描欄位陣列 */
+void compute_stats(const Schedule *s, ScheduleStats *st) {
+    int count = s ? s->count : store.count;
+    int c, i, n, dev;
+    memset(st, 0, sizeof(*st));
+    st->earliest = MAX_DAYS;
+    st->latest = -1;
+    for (c = 0; c * CHUNK_SIZE < count; c++) {
+        const ColumnChunk *col = store.columns[c];
+        const unsigned char *acc = s ? s->accepted + (size_t)c * CHUNK_SIZE : col->accepted;
+        int accepted = 0;
+        double parking = 0.0;
+        n = count - c * CHUNK_SIZE;
+        if (n > CHUNK_SIZE)
+            n = CHUNK_SIZE;
+        for (i = 0; i < n; i++) {
+            accepted += acc[i];
+            parking += (acc[i] && col->type[i] != TYPE_ESSENTIALS) ? col->duration[i] : 0.0;
+        }
+        st->accepted += accepted;
+        st->parkingHours += parking;
+        for (dev = 0; dev < deviceTable.count; dev++) {
+            unsigned int bit = 1u << dev;
+            double sum = 0.0;
+            for (i = 0; i < n; i++)
+                sum += (acc[i] && (col->essentials[i] & bit)) ? col->duration[i] : 0.0;
+            st->deviceHours[dev] += sum;
+        }
+        for (i = 0; i < n; i++) {
+            if (acc[i]) {
+                int date = col->date[i] + (s ? s->dayShift[c * CHUNK_SIZE + i] : 0);
+                if (date < st->earliest) st->earliest = date;
+                if (date > st->latest) st->latest = date;
+            }
+        }
+    }
+    st->rejected = count - st->accepted;
+    if (s == NULL)
+        return;
+    st->search = s->search;
+    st->preempted = s->preempted;
+    for (i = 0; i < count; i++) {
+        if (s->accepted[i] && s->startSlot[i] >= 0) {
+            int minutes = s->dayShift[i] * HOURS_PER_DAY * 60 +
+                          s->startSlot[i] * SLOT_MINUTES -
+                          store.columns[i >> CHUNK_SHIFT]->start[i & (CHUNK_SIZE - 1)];
+            st->moved++;
+            st->movedDays += s->dayShift[i] != 0;
+            st->shiftHours += abs(minutes) / 60.0;
+        }
+    }
+}
+
+/* 取得統計中某設備的使用時數，未曾出現的設備為 0 */
+static double device_hours(const ScheduleStats *st, const char *name) {
+    int id = name_find(&deviceTable, name, strlen(name));
+    return id < 0 ? 0.0 : st->deviceHours[id];
+}
+
+/* 將某一模式的統計結果加入報告 */
+void write_stats(ReportBuffer *r, const char *name, const ScheduleStats *st, int total) {
+    char outBuffer[1024];
+    const int available_hours_per_day = 12;
+    int days = st->latest - st->earliest + 1;
+    double parking_available, essential_available;
+    if (days <= 0) days = 1;
+    parking_available = PARKING_CAPACITY * days * available_hours_per_day;
+    essential_available = ESSENTIAL_CAPACITY * days * available_hours_per_day;
+
+    sprintf(outBuffer, "For %s:\n", name);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "  Total Number of Bookings Received: %d\n", total);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "  Number of Bookings Assigned: %d (%.1f%%)\n", st->accepted, total > 0 ? (st->accepted * 100.0 / total) : 0.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "  Number of Bookings Rejected: %d (%.1f%%)\n", st->rejected, total > 0 ? (st->rejected * 100.0 / total) : 0.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+    if (st->search != 0) {
+        sprintf(outBuffer, "  Search: %s\n", st->search == 1
+                ? "proven optimal over the requested times and whole-hour starts 08:00-20:00"
+                                                 : "time budget reached, best schedule found so far");
+        report_append(r, outBuffer, strlen(outBuffer));
+    }
+    if (st->moved > 0) {
+        sprintf(outBuffer, "  Number of Bookings Rescheduled: %d (%d to another day, average shift %.1f hours)\n",
+                st->moved, st->movedDays, st->shiftHours / st->moved);
+        report_append(r, outBuffer, strlen(outBuffer));
+    }
+    sprintf(outBuffer, "  Utilization of Time Slot:\n");
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "    Parking: %.1f%%\n", st->parkingHours / parking_available * 100.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "    Battery: %.1f%%\n", device_hours(st, "battery") / essential_available * 100.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "    Cable: %.1f%%\n", device_hours(st, "cable") / essential_available * 100.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "    Locker: %.1f%%\n", device_hours(st, "locker") / essential_available * 100.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "    Umbrella: %.1f%%\n", device_hours(st, "umbrella") / essential_available * 100.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "    Valet Parking: %.1f%%\n", device_hours(st, "valetPark") / essential_available * 100.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+    sprintf(outBuffer, "    Inflation Service: %.1f%%\n\n", device_hours(st, "inflationService") / essential_available * 100.0);
+    report_append(r, outBuffer, strlen(outBuffer));
+}
+
+/* 完整寫入 len 個位元組，失敗回傳 0 */
+int write_all(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    ssize_t n;
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+/* 經 socket 完整送出 len 個位元組；對方已結束時回傳 0 而不產生 SIGPIPE */
+static int send_all(int sock, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    ssize_t n;
+    while (len > 0) {
+        n = send(sock, p, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+/* 送出報告框架的標頭，並附上輸出用的描述子 fd */
+static int frame_send(int sock, const ReportFrame *frame, int fd) {
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = (void *)frame;
+    iov.iov_len = sizeof(*frame);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(*frame);
+}
+
+/* 接收報告框架的標頭及隨附的描述子；對方已結束或資料錯誤時回傳 0 */
+static int frame_recv(int sock, ReportFrame *frame, int *fd) {
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    ssize_t n;
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = frame;
+    iov.iov_len = sizeof(*frame);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    n = recvmsg(sock, &msg, 0);
+    if (n <= 0)
+        return 0;
+    cm = CMSG_FIRSTHDR(&msg);
+    if (cm == NULL || cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+        return 0;
+    memcpy(fd, CMSG_DATA(cm), sizeof(int));
+    if ((size_t)n < sizeof(*frame) && !read_all(sock, (char *)frame + n, sizeof(*frame) - (size_t)n)) {
+        close(*fd);
+        return 0;
+    }
+    return 1;
+}
+
+/* 等待 eventfd 被通知；傳送期間對方不會經 sock 送出任何資料，
+   因此 sock 變為可讀代表對方行程已結束，此時回傳 0 */
+static int ring_wait(int efd, int sock) {
+    struct pollfd fds[2];
+    uint64_t count;
+    fds[0].fd = efd;
+    fds[0].events = POLLIN;
+    fds[1].fd = sock;
+    fds[1].events = POLLIN;
+    while (poll(fds, 2, -1) < 0) {
+        if (errno != EINTR)
+            return 0;
+    }
+    if (fds[1].revents != 0)
+        return 0;
+    return read(efd, &count, sizeof(count)) == (ssize_t)sizeof(count);
+}
+
+/* 通知 eventfd 的另一方 */
+static void ring_notify(int efd) {
+    uint64_t one = 1;
+    while (write(efd, &one, sizeof(one)) < 0 && errno == EINTR)
+        ;
+}
+
+/* 主行程：把 len 個位元組放入環形緩衝區，空間不足時等待 reporter 取走；reporter 已結束時回傳 0 */
+static int ring_write(const char *text, size_t len, int sock) {
+    size_t head = reportRing->head, tail, n, at;
+    while (len > 0) {
+        tail = __atomic_load_n(&reportRing->tail, __ATOMIC_ACQUIRE);
+        if (head - tail == REPORT_RING_SIZE) {
+            if (!ring_wait(ringSpace, sock))
+                return 0;
+            continue;
+        }
+        at = head % REPORT_RING_SIZE;
+        n = REPORT_RING_SIZE - (head - tail);
+        if (n > REPORT_RING_SIZE - at)
+            n = REPORT_RING_SIZE - at;
+        if (n > len)
+            n = len;
+        memcpy(reportRing->data + at, text, n);
+        head += n;
+        text += n;
+        len -= n;
+        __atomic_store_n(&reportRing->head, head, __ATOMIC_RELEASE);
+        ring_notify(ringData);
+    }
+    return 1;
+}
+
+/* reporter：從環形緩衝區取出 len 個位元組寫到 fd，直接由共享記憶體寫出，不另行複製；
+   主行程已結束時回傳 0 */
+static int ring_read(int fd, size_t len, int sock) {
+    size_t tail = reportRing->tail, head, n, at;
+    while (len > 0) {
+        head = __atomic_load_n(&reportRing->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (!ring_wait(ringData, sock))
+                return 0;
+            continue;
+        }
+        at = tail % REPORT_RING_SIZE;
+        n = head - tail;
+        if (n > REPORT_RING_SIZE - at)
+            n = REPORT_RING_SIZE - at;
+        if (n > len)
+            n = len;
+        write_all(fd, reportRing->data + at, n);
+        tail += n;
+        len -= n;
+        __atomic_store_n(&reportRing->tail, tail, __ATOMIC_RELEASE);
+        ring_notify(ringSpace);
+    }
+    return 1;
+}
+
+/* reporter 行程：逐一接收報告框架，以 REPORT_CHUNK 大小的區塊寫到隨框架傳來的描述子，
+   寫完後回覆一個位元組；主行程結束（socket 關閉）時隨之結束 */
+static void reporter_main(int sock) {
+    ReportFrame frame;
+    char *buffer = (char *)malloc(REPORT_CHUNK);
+    size_t left, n;
+    int fd;
+    signal(SIGPIPE, SIG_IGN);       /* 伺服器模式的客戶端可能已離線 */
+    while (buffer != NULL && frame_recv(sock, &frame, &fd)) {
+        if (reportRing != NULL) {
+            if (!ring_read(fd, frame.len, sock))
+                _exit(1);
+            close(fd);
+            if (!write_all(sock, "", 1))
+                break;
+            continue;
+        }
+        for (left = frame.len; left > 0; left -= n) {
+            n = left < REPORT_CHUNK ? left : REPORT_CHUNK;
+            if (!read_all(sock, buffer, n))
+                _exit(1);
+            write_all(fd, buffer, n);
+        }
+        close(fd);
+        if (!write_all(sock, "", 1))
+            break;
+    }
+    _exit(0);
+}
+
+/* 建立 -report shm 的共享記憶體環形緩衝區及 eventfd，須在 fork reporter 之前呼叫 */
+static int ring_create(void) {
+    void *p = mmap(NULL, sizeof(ReportRing), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return 0;
+    ringData = eventfd(0, 0);
+    ringSpace = eventfd(0, 0);
+    if (ringData < 0 || ringSpace < 0) {
+        if (ringData >= 0)
+            close(ringData);
+        if (ringSpace >= 0)
+            close(ringSpace);
+        munmap(p, sizeof(ReportRing));
+        return 0;
+    }
+    reportRing = (ReportRing *)p;
+    return 1;
+}
+
+/* 建立 reportLock：行程間共用；持有者中途結束時（robust）下一個行程仍可取得 */
+static pthread_mutex_t *report_lock_create(void) {
+    pthread_mutexattr_t attr;
+    void *p = mmap(NULL, sizeof(pthread_mutex_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    if (pthread_mutex_init((pthread_mutex_t *)p, &attr) != 0) {
+        pthread_mutexattr_destroy(&attr);
+        munmap(p, sizeof(pthread_mutex_t));
+        return NULL;
+    }
+    pthread_mutexattr_destroy(&attr);
+    return (pthread_mutex_t *)p;
+}
+
+static void report_lock(void) {
+    if (reportLock != NULL && pthread_mutex_lock(reportLock) == EOWNERDEAD)
+        pthread_mutex_consistent(reportLock);
+}
+
+static void report_unlock(void) {
+    if (reportLock != NULL)
+        pthread_mutex_unlock(reportLock);
+}
+
+/* 啟動常駐的 reporter 行程，程式開始時呼叫一次，此時的行程很小，fork 的成本很低；
+   之後的報告不再逐次 fork，而是整批交給它輸出。shm 為 1 時報告內容改經共享記憶體傳送，
+   socket 只傳遞框架標頭及確認 */
+int reporter_start(int shm) {
+    int sv[2];
+    pid_t pid;
+    if (shm && !ring_create())
+        printf("Error: Cannot create the shared-memory report ring, using the socket\n");
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+        return 0;
+    reportLock = report_lock_create();
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        return 0;
+    }
+    if (pid == 0) {
+        close(sv[0]);
+        reporter_main(sv[1]);
+    }
+    close(sv[1]);
+    reporterSock = sv[0];
+    return 1;
+}
+
+/* 把報告內容交給 reporter 輸出到目前的標準輸出，並等待完成以保持輸出順序；
+   框架連同確認在 reportLock 內完成，多個報告子行程因此不會交錯使用 socket 及環形緩衝區。
+   reporter 無法使用時改由本行程直接寫出 */
+void report_send(ReportBuffer *r) {
+    ReportFrame frame;
+    char ack;
+    int sent = 0;
+    if (r->len == 0)
+        return;
+    fflush(stdout);
+    frame.len = r->len;
+    if (reporterSock >= 0) {
+        report_lock();
+        if (reportRing != NULL && frame_send(reporterSock, &frame, STDOUT_FILENO)) {
+            /* reporter 中途結束時無法確定已輸出多少，這份內容只能捨棄 */
+            sent = 1;
+            if (!ring_write(r->data, r->len, reporterSock) || !read_all(reporterSock, &ack, 1)) {
+                close(reporterSock);
+                reporterSock = -1;
+            }
+        } else if (reportRing == NULL && frame_send(reporterSock, &frame, STDOUT_FILENO) &&
+                   send_all(reporterSock, r->data, r->len) && read_all(reporterSock, &ack, 1)) {
+            sent = 1;
+        } else {
+            close(reporterSock);
+            reporterSock = -1;
+        }
+        report_unlock();
+    }
+    if (!sent)
+        write_all(STDOUT_FILENO, r->data, r->len);
+    r->len = 0;
+}
+
+/* 將文字加入報告；累積到 REPORT_FRAME_SIZE 時先送出，緩衝區大小因此有上限 */
+void report_append(ReportBuffer *r, const char *text, size_t len) {
+    if (r->len + len > r->capacity) {
+        size_t capacity = r->capacity ? r->capacity : 65536;
+        char *data;
+        while (capacity < r->len + len)
+            capacity *= 2;
+        data = (char *)realloc(r->data, capacity);
+        if (data == NULL) {
+            report_send(r);
+            write_all(STDOUT_FILENO, text, len);
+            return;
+        }
+        r->data = data;
+        r->capacity = capacity;
+    }
+    memcpy(r->data + r->len, text, len);
+    r->len += len;
+    if (r->len >= REPORT_FRAME_SIZE)
+        report_send(r);
+}
+
+/* 完整讀取 len 個位元組，失敗或提早結束回傳 0 */
+int read_all(int fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    ssize_t n;
+    while (len > 0) {
+        n = read(fd, p, len);
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+/* 發佈目前的預約數及 FCFS 統計，之後取得的快照即包含這些預約 */
+void store_publish(void) {
+    published.count = store.count;
+    published.generation = store.generation;
+    published.fcfs = fcfsStats;
+}
+
+/* 取得最近發佈的快照；報告之後只讀取快照範圍內的預約 */
+void snapshot_take(Snapshot *snap) {
+    *snap = published;
+}
+
+/* 停止記錄（寫入失敗等），已緩衝的內容捨棄 */
+static void journal_stop(void) {
+    close(journal.fd);
+    journal.fd = -1;
+    journal.used = 0;
+}
+
+/* 將一筆記錄放入日誌緩衝區，緩衝區已滿時先寫出 */
+static void journal_put(int kind, int index, const void *payload, size_t len) {
+    JournalRecord rec;
+    if (journal.fd < 0)
+        return;
+    if (len > 0xFFFF) {  /* rec.len 無法表示；名稱已受 MAX_NAME_LENGTH 限制 */
+        printf("Error: journal record too large, journaling stopped\n");
+        journal_stop();
+        return;
+    }
+    if (journal.used + sizeof(rec) + len > sizeof(journal.buffer))
+        journal_flush();
+    if (journal.fd < 0)
+        return;
+    rec.kind = (unsigned short)kind;
+    rec.len = (unsigned short)len;
+    rec.index = index;
+    rec.check = (unsigned int)name_hash((const char *)payload, len);
+    if (sizeof(rec) + len > sizeof(journal.buffer)) {  /* 放不進緩衝區的記錄直接寫出 */
+        if (!write_all(journal.fd, &rec, sizeof(rec)) || !write_all(journal.fd, payload, len)) {
+            perror(journal.journalPath);
+            journal_stop();
+        }
+        return;
+    }
+    memcpy(journal.buffer + journal.used, &rec, sizeof(rec));
+    memcpy(journal.buffer + journal.used + sizeof(rec), payload, len);
+    journal.used += (int)(sizeof(rec) + len);
+}
+
+/* 記錄名稱表中尚未寫入日誌的名稱；名稱依 id 順序寫入，重播時得到相同的 id */
+static void journal_names(NameTable *t, int kind, int *written) {
+    for (; *written < t->count; (*written)++)
+        journal_put(kind, *written, t->names[*written], strlen(t->names[*written]));
+}
+
+/* 記錄剛存入位置 index 的預約（連同其 FCFS 決定） */
+void journal_booking(const Booking *b, int index) {
+    journal_names(&memberTable, JOURNAL_MEMBER, &journal.memberCount);
+    journal_names(&deviceTable, JOURNAL_DEVICE, &journal.deviceCount);
+    journal_put(JOURNAL_BOOKING, index, b, sizeof(Booking));
+    journal.bookings++;
+}
+
+/* 將緩衝區寫入日誌檔；失敗時停止記錄 */
+void journal_flush(void) {
+    if (journal.fd < 0 || journal.used == 0)
+        return;
+    if (!write_all(journal.fd, journal.buffer, (size_t)journal.used)) {
+        perror(journal.journalPath);
+        journal_stop();
+    }
+    journal.used = 0;
+}
+
+/* 每個命令結束時呼叫：寫出日誌，累積足夠的預約後另存檢查點 */
+void journal_commit(void) {
+    if (journal.fd < 0)
+        return;
+    journal_flush();
+    if (journal.bookings >= JOURNAL_CHECKPOINT_BOOKINGS)
+        checkpoint_write();
+}
+
+/* 把整個儲存區寫成檢查點（先寫暫存檔再改名），成功後清空日誌 */
+int checkpoint_write(void) {
+    CheckpointHeader h;
+    char tmpPath[MAX_PATH_LENGTH + 4];
+    static const char pad[8] = { 0 };
+    long offset;
+    int fd, id, c, n, ok;
+
+    journal_flush();
+    if (journal.fd < 0)
+        return 0;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+    h.bookingSize = (int)sizeof(Booking);
+    h.count = store.count;
+    h.memberCount = memberTable.count;
+    h.deviceCount = deviceTable.count;
+    offset = (long)sizeof(h);
+    for (id = 0; id < memberTable.count; id++)
+        offset += (long)strlen(memberTable.names[id]) + 1;
+    for (id = 0; id < deviceTable.count; id++)
+        offset += (long)strlen(deviceTable.names[id]) + 1;
+    h.bookingOffset = (offset + 7) & ~7L;
+
+    sprintf(tmpPath, "%s.tmp", journal.checkpointPath);
+    fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(tmpPath);
+        return 0;
+    }
+    ok = write_all(fd, &h, sizeof(h));
+    for (id = 0; ok && id < memberTable.count; id++)
+        ok = write_all(fd, memberTable.names[id], strlen(memberTable.names[id]) + 1);
+    for (id = 0; ok && id < deviceTable.count; id++)
+        ok = write_all(fd, deviceTable.names[id], strlen(deviceTable.names[id]) + 1);
+    if (ok)
+        ok = write_all(fd, pad, (size_t)(h.bookingOffset - offset));
+    for (c = 0; ok && c * CHUNK_SIZE < store.count; c++) {
+        n = store.count - c * CHUNK_SIZE;
+        if (n > CHUNK_SIZE)
+            n = CHUNK_SIZE;
+        ok = write_all(fd, store.chunks[c], sizeof(Booking) * (size_t)n);
+    }
+    if (ok)
+        ok = fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath, journal.checkpointPath) != 0) {
+        perror(journal.checkpointPath);
+        unlink(tmpPath);
+        return 0;
+    }
+    /* 日誌中的記錄已全部包含在檢查點內；即使清空前中斷，重播時也會依 index 略過 */
+    if (ftruncate(journal.fd, 0) != 0)
+        perror(journal.journalPath);
+    journal.bookings = 0;
+    return 1;
+}
+
+/* 還原一筆已有 FCFS 決定的預約，不重新檢查資源 */
+static int restore_booking(const Booking *b) {
+    if (b->member < 0 || b->member >= memberTable.count || b->date < 0 || b->date >= MAX_DAYS ||
+        store_append(b) == NULL)
+        return 0;
+    if (b->accepted)
+        occupancy_add(booking_at(store.count - 1));
+    stats_add(&fcfsStats, b);
+    return 1;
+}
+
+/* 以 mmap 載入檢查點；檔案不存在回傳 1，格式錯誤回傳 0 */
+static int checkpoint_load(const char *path) {
+    CheckpointHeader h;
+    struct stat st;
+    const char *data, *p, *end;
+    const Booking *bookings;
+    int fd, i, ok = 1;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return errno == ENOENT;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(h)) {
+        close(fd);
+        return 0;
+    }
+    data = (const char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+    memcpy(&h, data, sizeof(h));
+    if (memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0 || h.bookingSize != (int)sizeof(Booking) ||
+        h.count < 0 || h.bookingOffset < (long)sizeof(h) ||
+        (off_t)h.bookingOffset + (off_t)h.count * (off_t)sizeof(Booking) > st.st_size) {
+        munmap((void *)data, (size_t)st.st_size);
+        return 0;
+    }
+    p = data + sizeof(h);
+    end = data + h.bookingOffset;
+    for (i = 0; ok && i < h.memberCount + h.deviceCount; i++) {
+        const char *name = p;
+        while (p < end && *p != '\0')
+            p++;
+        if (p == end)
+            ok = 0;
+        else if (i < h.memberCount)
+            ok = name_intern(&memberTable, name, (size_t)(p - name)) == i;
+        else
+            ok = name_intern(&deviceTable, name, (size_t)(p - name)) == i - h.memberCount;
+        p++;
+    }
+    bookings = (const Booking *)(data + h.bookingOffset);
+    for (i = 0; ok && i < h.count; i++)
+        ok = restore_booking(&bookings[i]);
+    munmap((void *)data, (size_t)st.st_size);
+    return ok;
+}
+
+/* 重播日誌中檢查點之後的記錄，回傳有效記錄的結尾位置；不完整的尾端記錄被忽略 */
+static long journal_replay(const char *data, long size, int *replayed) {
+    JournalRecord rec;
+    const char *payload;
+    long offset = 0;
+    Booking b;
+    while (offset + (long)sizeof(rec) <= size) {
+        memcpy(&rec, data + offset, sizeof(rec));
+        payload = data + offset + sizeof(rec);
+        if (offset + (long)sizeof(rec) + rec.len > size ||
+            rec.check != (unsigned int)name_hash(payload, rec.len))
+            break;
+        if (rec.kind == JOURNAL_BOOKING && rec.len == sizeof(Booking)) {
+            if (rec.index > store.count)
+                break;
+            if (rec.index == store.count) {
+                memcpy(&b, payload, sizeof(b));
+                if (!restore_booking(&b))
+                    break;
+                (*replayed)++;
+            }
+        } else if (rec.kind == JOURNAL_MEMBER || rec.kind == JOURNAL_DEVICE) {
+            NameTable *t = rec.kind == JOURNAL_MEMBER ? &memberTable : &deviceTable;
+            if (rec.index > t->count)
+                break;
+            if (rec.index == t->count && name_intern(t, payload, rec.len) != rec.index)
+                break;
+        } else {
+            break;
+        }
+        offset += (long)sizeof(rec) + rec.len;
+    }
+    return offset;
+}
+
+/* 開啟 dir 中的日誌：載入檢查點、重播日誌尾端，之後的預約都會寫入日誌 */
+int journal_open(const char *dir) {
+    struct stat st;
+    const char *data;
+    double start = now_ms();
+    long valid = 0;
+    int fd, replayed = 0;
+
+    if (strlen(dir) + 20 > MAX_PATH_LENGTH) {
+        printf("Error: Data directory path too long\n");
+        return 0;
+    }
+    mkdir(dir, 0755);
+    sprintf(journal.journalPath, "%s/spms.journal", dir);
+    sprintf(journal.checkpointPath, "%s/spms.checkpoint", dir);
+    if (!checkpoint_load(journal.checkpointPath)) {
+        printf("Error: Cannot load checkpoint %s\n", journal.checkpointPath);
+        return 0;
+    }
+    fd = open(journal.journalPath, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(journal.journalPath);
+        return 0;
+    }
+    if (st.st_size > 0) {
+        data = (const char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            perror(journal.journalPath);
+            close(fd);
+            return 0;
         }
+        valid = journal_replay(data, (long)st.st_size, &replayed);
+        munmap((void *)data, (size_t)st.st_size);
+        /* 截去不完整的尾端，之後的記錄才能接續在有效記錄之後 */
+        if (valid < (long)st.st_size && ftruncate(fd, (off_t)valid) != 0)
+            perror(journal.journalPath);
     }
-    strcpy(b.type, "Event");
-    b.requires_parking = 1;
-    b.accepted = check_availability(&b) ? 1 : 0;
-    bookings[bookingCount++] = b;
-    printf("-> [Pending]\n");
+    journal.fd = fd;
+    journal.memberCount = memberTable.count;
+    journal.deviceCount = deviceTable.count;
+    journal.bookings = replayed;
+    store_publish();
+    printf("-> Restored %d bookings (%d from journal) in %.1f ms\n",
+           store.count, replayed, now_ms() - start);
+    return 1;
 }
 
-/* bookEssentials -member_X YYYY-MM-DD hh:mm duration essential; */
-void process_bookEssentials(char *line) {
-    char *token;
-    Booking b;
-    int i;
-    for (i = 0; i < (int)sizeof(b); i++) {
-        ((char *)&b)[i] = 0;
-    }
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.member, normalize_member(token));
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.date, token);
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    strcpy(b.time, token);
-    token = strtok(NULL, " ");
-    if (token == NULL) return;
-    b.duration = (float)atof(token);
-    token = strtok(NULL, " ;\n");
-    if (token != NULL)
-        strcpy(b.essential1, token);
-    strcpy(b.type, "Essentials");
-    b.requires_parking = 0;
-    b.accepted = check_availability(&b) ? 1 : 0;
-    bookings[bookingCount++] = b;
-    printf("-> [Pending]\n");
+/* 結束前寫入檢查點，下次啟動便不需重播日誌 */
+void journal_close(void) {
+    if (journal.fd < 0)
+        return;
+    if (journal.bookings > 0)
+        checkpoint_write();
+    journal_flush();
+    close(journal.fd);
+    journal.fd = -1;
 }
 
-/* addBatch -batchfile */
-void process_addBatch(char *line) {
-    char *token;
-    FILE *fp;
-    char batchLine[MAX_LINE_LENGTH];
-    token = strtok(NULL, " ;\n");
-    if (token == NULL) return;
-    if (token[0] == '-' || (unsigned char)token[0] == 0xE2)
-        token++;  /* Skip leading dash */
-    fp = fopen(token, "r");
-    if (!fp) {
-        printf("Error: Cannot open batch file %s\n", token);
-        return;
-    }
-    while (fgets(batchLine, sizeof(batchLine), fp)) {
-        batchLine[strcspn(batchLine, "\n")] = '\0';
-        process_command(batchLine);
-    }
-    fclose(fp);
-    printf("-> [Pending]\n");
+/* 快取是否對應快照中的預約資料 */
+int cache_valid(const ScheduleCache *c, const Snapshot *snap) {
+    return c->valid && c->generation == snap->generation;
 }
 
-/* 輸出預約記錄（依 FCFS 或 PRIO 模式排序） */
-void process_printBookings(char *line) {
-    char *token;
-    int pipefd[2];
-    pid_t pid;
-    char outBuffer[1024];
-    int i, n;
-    char algorithm[10];
+/* 以新的排程結果取代快取內容（排程陣列的擁有權轉移給快取） */
+void cache_store(ScheduleCache *c, Schedule *sched, const ScheduleStats *st, unsigned long generation) {
+    if (c->valid)
+        schedule_free(&c->sched);
+    c->sched = *sched;
+    c->stats = *st;
+    c->generation = generation;
+    c->valid = 1;
+}
 
-    // 讀取使用者指定模式 (-fcfs 或 -prio)
-    token = strtok(line, " ");
-    token = strtok(NULL, " ;\n");  /* 預期為 "-fcfs" 或 "-prio" */
-    if (token != NULL) {
-        token = normalize_member(token);
-        if (strcmp(token, "PRIO") == 0 || strcmp(token, "prio") == 0)
-            strcpy(algorithm, "PRIO");
-        else
-            strcpy(algorithm, "FCFS");
+/* 捨棄快取內容（如排程設定改變時） */
+void cache_clear(ScheduleCache *c) {
+    if (c->valid)
+        schedule_free(&c->sched);
+    c->valid = 0;
+    c->epoch++;
+}
+
+/* 排程演算法對應的延遲統計 */
+static int scheduler_stat(void (*simulate)(Schedule *)) {
+    if (simulate == simulate_PRIO)
+        return STAT_PRIO;
+    return simulate == simulate_OPTI ? STAT_OPTI : STAT_OPTI_EXACT;
+}
+
+/* 取得快照的排程結果：快照與上次模擬相同則直接重用，否則重新模擬；
+   simulate 為 NULL 代表 FCFS（直接使用收錄時的決定） */
+const ScheduleCache *cached_schedule(ScheduleCache *c, void (*simulate)(Schedule *), const Snapshot *snap) {
+    Schedule sched;
+    ScheduleStats st;
+    double start;
+    if (cache_valid(c, snap))
+        return c;
+    if (!schedule_init(&sched, snap->count))
+        return NULL;
+    if (simulate != NULL) {
+        start = now_ms();
+        simulate(&sched);
+        latency_record(scheduler_stat(simulate), start);
+        compute_stats(&sched, &st);
     } else {
-        strcpy(algorithm, "FCFS");
+        st = snap->fcfs;
     }
+    cache_store(c, &sched, &st, snap->generation);
+    return c;
+}
 
-    // 根據模式建立要印出的預約陣列
-    Booking displayBookings[MAX_BOOKINGS];
-    if (strcmp(algorithm, "PRIO") == 0) {
-        // PRIO 模式下先模擬優先調度
-        simulate_PRIO(bookings, displayBookings, bookingCount);
-    } else {
-        // FCFS 模式直接使用全局預約記錄
-        memcpy(displayBookings, bookings, sizeof(Booking) * bookingCount);
+/* 建立子行程執行 PRIO 或 OPTI 模擬，排程結果及統計經 pipe 傳回父行程 */
+int start_schedule_worker(ScheduleWorker *w, void (*simulate)(Schedule *), const Snapshot *snap) {
+    int pipefd[2];
+    Schedule sched;
+    ScheduleStats st;
+    if (pipe(pipefd) == -1)
+        return 0;
+    fflush(stdout);
+    w->stat = scheduler_stat(simulate);
+    w->start = now_ms();
+    w->pid = fork();
+    if (w->pid < 0) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return 0;
     }
-    
-    if (pipe(pipefd) == -1) {
-        perror("pipe");
-        return;
+    if (w->pid == 0) {  /* 子行程：模擬後寫回統計及每筆預約的決定 */
+        close(pipefd[0]);
+        if (!schedule_init(&sched, snap->count))
+            _exit(1);
+        simulate(&sched);
+        compute_stats(&sched, &st);
+        if (!write_all(pipefd[1], &st, sizeof(st)) ||
+            !write_all(pipefd[1], sched.accepted, (size_t)sched.count) ||
+            !write_all(pipefd[1], sched.startSlot, sizeof(short) * (size_t)sched.count) ||
+            !write_all(pipefd[1], sched.dayShift, sizeof(short) * (size_t)sched.count))
+            _exit(1);
+        close(pipefd[1]);
+        _exit(0);
     }
+    close(pipefd[1]);
+    w->fd = pipefd[0];
+    return 1;
+}
 
-    pid = fork();
-    if (pid < 0) {
-        perror("fork");
-        return;
+/* 等待子行程完成並將結果存入快取，失敗回傳 0 */
+int finish_schedule_worker(ScheduleWorker *w, ScheduleCache *c, const Snapshot *snap) {
+    Schedule sched;
+    ScheduleStats st;
+    int ok = schedule_init(&sched, snap->count);
+    ok = ok && read_all(w->fd, &st, sizeof(st)) &&
+         read_all(w->fd, sched.accepted, (size_t)sched.count) &&
+         read_all(w->fd, sched.startSlot, sizeof(short) * (size_t)sched.count) &&
+         read_all(w->fd, sched.dayShift, sizeof(short) * (size_t)sched.count);
+    close(w->fd);
+    waitpid(w->pid, NULL, 0);
+    if (ok) {
+        latency_record(w->stat, w->start);  /* 包括子行程的建立及結果傳回 */
+        cache_store(c, &sched, &st, snap->generation);
     }
+    else
+        schedule_free(&sched);
+    return ok;
+}
 
-    if (pid == 0) {
-        close(pipefd[1]);
-        while ((n = read(pipefd[0], outBuffer, sizeof(outBuffer)-1)) > 0) {
-            outBuffer[n] = '\0';
-            printf("%s", outBuffer);
-        }
-        close(pipefd[0]);
-        exit(0);
-    } else {
-        close(pipefd[0]);
-        sprintf(outBuffer, "\n** Parking Booking – ACCEPTED / %s **\n", algorithm);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-
-        // 處理已接受的預約
-        {
-            char *members[] = {"member_A", "member_B", "member_C", "member_D", "member_E"};
-            int numMembers = 5;
-            int foundAnyAccepted = 0;
-            int j, k;
-            for (i = 0; i < numMembers; i++) {
-                int count = 0;
-                Booking *memberBookings[MAX_BOOKINGS];
-                int memberCount = 0;
-                for (j = 0; j < bookingCount; j++) {
-                    if (displayBookings[j].accepted && strcmp(displayBookings[j].member, members[i]) == 0) {
-                        memberBookings[memberCount++] = &displayBookings[j];
-                        count++;
-                    }
-                }
+/* 輸出綜合報告：分別統計 FCFS、PRIO 與 OPTI 模式，
+   PRIO、OPTI 與 OPTI_EXACT 互不相關，未有快取結果時分別交由子行程同時模擬 */
+void process_printSummary(void) {
+    Snapshot snap;
+    double outputStart;
+    int total;
+    ScheduleWorker prio_worker, opti_worker, exact_worker;
+    int prio_started, opti_started, exact_started;
+    const ScheduleCache *prio, *opti, *exact;
+    char outBuffer[1024];
 
-                if (count > 0) {
-                    foundAnyAccepted = 1;
-                    sprintf(outBuffer, "%s has the following bookings:\n", members[i]);
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    sprintf(outBuffer, "Date       Start End   Type         Device\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    sprintf(outBuffer, "===========================================================================\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-
-                    if (strcmp(algorithm, "PRIO") == 0 && memberCount > 1)
-                        qsort(memberBookings, memberCount, sizeof(Booking *), cmp_priority); // 按優先權排序
-
-                    for (k = 0; k < memberCount; k++) {
-                        int hour, minute;
-                        sscanf(memberBookings[k]->time, "%d:%d", &hour, &minute);
-                        int endHour = hour + (int)(memberBookings[k]->duration);
-                        char endTime[6];
-                        sprintf(endTime, "%02d:%02d", endHour, minute);
-
-                        char typeStr[20];
-                        if (strcmp(memberBookings[k]->type, "Essentials") == 0)
-                            strcpy(typeStr, "*");
-                        else
-                            strcpy(typeStr, memberBookings[k]->type);
-
-                        char deviceStr[100] = "";
-                        if (strcmp(memberBookings[k]->type, "Essentials") == 0) {
-                            if (strlen(memberBookings[k]->essential1) > 0)
-                                strcpy(deviceStr, memberBookings[k]->essential1);
-                            else
-                                strcpy(deviceStr, "*");
-                        } else {
-                            if (strlen(memberBookings[k]->essential1) > 0)
-                                strcpy(deviceStr, memberBookings[k]->essential1);
-                            if (strlen(memberBookings[k]->essential2) > 0) {
-                                if (strlen(deviceStr) > 0) {
-                                    strcat(deviceStr, " ");
-                                    strcat(deviceStr, memberBookings[k]->essential2);
-                                } else {
-                                    strcpy(deviceStr, memberBookings[k]->essential2);
-                                }
-                            }
-                            if (strlen(deviceStr) == 0)
-                                strcpy(deviceStr, "*");
-                        }
+    snapshot_take(&snap);
+    total = snap.count;
+    prio_started = !cache_valid(&prioCache, &snap) && start_schedule_worker(&prio_worker, simulate_PRIO, &snap);
+    opti_started = !cache_valid(&optiCache, &snap) && start_schedule_worker(&opti_worker, simulate_OPTI, &snap);
+    exact_started = !cache_valid(&exactCache, &snap) &&
+                    start_schedule_worker(&exact_worker, simulate_OPTI_EXACT, &snap);
 
-                        char bookingLine[256];
-                        sprintf(bookingLine, "%-10s %-5s %-5s %-12s %s\n",
-                                memberBookings[k]->date,
-                                memberBookings[k]->time,
-                                endTime,
-                                typeStr,
-                                deviceStr);
-                        write(pipefd[1], bookingLine, strlen(bookingLine));
-                    }
-                    sprintf(outBuffer, "\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                }
-            }
+    /* === PRIO / OPTI 模擬計算，子行程失敗時改為在本行程計算 === */
+    if (prio_started)
+        finish_schedule_worker(&prio_worker, &prioCache, &snap);
+    if (opti_started)
+        finish_schedule_worker(&opti_worker, &optiCache, &snap);
+    if (exact_started)
+        finish_schedule_worker(&exact_worker, &exactCache, &snap);
+    prio = cached_schedule(&prioCache, simulate_PRIO, &snap);
+    opti = cached_schedule(&optiCache, simulate_OPTI, &snap);
+    exact = cached_schedule(&exactCache, simulate_OPTI_EXACT, &snap);
+    if (prio == NULL || opti == NULL || exact == NULL) {
+        printf("Error: Out of memory\n");
+        return;
+    }
 
-            if (foundAnyAccepted) {
-                sprintf(outBuffer, "- End -\n");
-                write(pipefd[1], outBuffer, strlen(outBuffer));
-            } else {
-                sprintf(outBuffer, "No accepted bookings.\n");
-                write(pipefd[1], outBuffer, strlen(outBuffer));
-            }
+    /* === 組成綜合報告，交由 reporter 行程輸出 === */
+    outputStart = now_ms();
+    sprintf(outBuffer, "\n** Parking Booking Manager – Summary Report **\n\n");
+    report_append(&report, outBuffer, strlen(outBuffer));
 
-            sprintf(outBuffer, "===========================================================================\n");
-            write(pipefd[1], outBuffer, strlen(outBuffer));
-        }
-
-        // 輸出拒絕的預約
-        sprintf(outBuffer, "\n** Parking Booking – REJECTED / %s **\n", algorithm);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-
-        {
-            char *members[] = {"member_A", "member_B", "member_C", "member_D", "member_E"};
-            int numMembers = 5;
-            int foundAnyRejected = 0;
-            int j, k;
-            for (i = 0; i < numMembers; i++) {
-                int count = 0;
-                Booking *memberBookings[MAX_BOOKINGS];
-                int memberCount = 0;
-                for (j = 0; j < bookingCount; j++) {
-                    if (!displayBookings[j].accepted && strcmp(displayBookings[j].member, members[i]) == 0) {
-                        memberBookings[memberCount++] = &displayBookings[j];
-                        count++;
-                    }
-                }
+    sprintf(outBuffer, "\nPerformance:\n\n");
+    report_append(&report, outBuffer, strlen(outBuffer));
 
-                if (count > 0) {
-                    foundAnyRejected = 1;
-                    sprintf(outBuffer, "%s (there are %d bookings rejected):\n", members[i], count);
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    sprintf(outBuffer, "Date       Start End   Type         Essentials\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    sprintf(outBuffer, "===========================================================================\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-
-                    if (strcmp(algorithm, "PRIO") == 0 && memberCount > 1)
-                        qsort(memberBookings, memberCount, sizeof(Booking *), cmp_priority);
-
-                    for (k = 0; k < memberCount; k++) {
-                        int hour, minute;
-                        sscanf(memberBookings[k]->time, "%d:%d", &hour, &minute);
-                        int endHour = hour + (int)(memberBookings[k]->duration);
-                        char endTime[6];
-                        sprintf(endTime, "%02d:%02d", endHour, minute);
-
-                        char typeStr[20];
-                        strcpy(typeStr, memberBookings[k]->type);
-
-                        char essStr[100] = "";
-                        if (strcmp(memberBookings[k]->type, "Essentials") == 0) {
-                            if (strlen(memberBookings[k]->essential1) > 0)
-                                strcpy(essStr, memberBookings[k]->essential1);
-                            else
-                                strcpy(essStr, "-");
-                        } else {
-                            if (strlen(memberBookings[k]->essential1) > 0)
-                                strcpy(essStr, memberBookings[k]->essential1);
-                            if (strlen(memberBookings[k]->essential2) > 0) {
-                                if (strlen(essStr) > 0) {
-                                    strcat(essStr, " ");
-                                    strcat(essStr, memberBookings[k]->essential2);
-                                } else {
-                                    strcpy(essStr, memberBookings[k]->essential2);
-                                }
-                            }
-                            if (strlen(essStr) == 0)
-                                strcpy(essStr, "-");
-                        }
+    /* FCFS 統計在收錄預約時已即時更新 */
+    write_stats(&report, "FCFS", &snap.fcfs, total);
+    write_stats(&report, "PRIO", &prio->stats, total);
+    write_stats(&report, "OPTI", &opti->stats, total);
+    write_stats(&report, "OPTI_EXACT", &exact->stats, total);
 
-                        char bookingLine[256];
-                        sprintf(bookingLine, "%-10s %-5s %-5s %-12s %s\n",
-                                memberBookings[k]->date,
-                                memberBookings[k]->time,
-                                endTime,
-                                typeStr,
-                                essStr);
-                        write(pipefd[1], bookingLine, strlen(bookingLine));
-                    }
-                    sprintf(outBuffer, "\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                }
-            }
+    report_send(&report);
+    latency_record(STAT_REPORT_OUTPUT, outputStart);
+    printf("-> [Done!]\n");
+}
 
-            if (foundAnyRejected) {
-                sprintf(outBuffer, "- End -\n");
-                write(pipefd[1], outBuffer, strlen(outBuffer));
-            } else {
-                sprintf(outBuffer, "No rejected bookings.\n");
-                write(pipefd[1], outBuffer, strlen(outBuffer));
-            }
-            sprintf(outBuffer, "===========================================================================\n");
-            write(pipefd[1], outBuffer, strlen(outBuffer));
-        }
 
-        close(pipefd[1]);
-        wait(NULL);
-        printf("-> [Done!]\n");
+/* 將自 start（now_ms 時間）起的延遲計入統計 */
+void latency_record(int stat, double start) {
+    LatencyHistogram *h = &latency[stat];
+    double us = (now_ms() - start) * 1000.0;
+    int k = 0;
+    while (k < LATENCY_BUCKETS - 1 && us >= (double)(2UL << k))
+        k++;
+    h->count++;
+    h->totalUs += us;
+    if (us > h->maxUs)
+        h->maxUs = us;
+    h->buckets[k]++;
+}
+
+/* 依直方圖估計第 q 分位數：回傳所在區間的上限（微秒） */
+static double latency_quantile(const LatencyHistogram *h, double q) {
+    long seen = 0;
+    int k;
+    for (k = 0; k < LATENCY_BUCKETS; k++) {
+        seen += h->buckets[k];
+        if (seen >= q * h->count)
+            break;
     }
+    return k < LATENCY_BUCKETS - 1 ? (double)(2UL << k) : h->maxUs;
 }
 
-/* 輸出綜合報告：分別統計 FCFS、PRIO 與 OPTI 模式 */
-void process_printSummary(void) {
-    int i;
-    int total = bookingCount;
-    const int available_hours_per_day = 12;
+/* printStats [-json]：輸出各命令及排程演算法的延遲統計，以及預約的接受、拒絕及被搶占數目；
+   -json 以單行 JSON 輸出同樣的資料（包括直方圖各區間）供程式讀取。
+   PRIO 被搶占數取自最近一次對目前預約資料的 PRIO 排程，尚未排程時為 -1 */
+void process_printStats(char *line) {
+    char *token;
+    Snapshot snap;
+    int json, k, stat, preempted;
+    token = strtok(line, " ;\n");
+    token = strtok(NULL, " ;\n");
+    json = token != NULL && strcmp(normalize_member(token), "json") == 0;
+    snapshot_take(&snap);
+    preempted = cache_valid(&prioCache, &snap) ? prioCache.stats.preempted : -1;
 
-    /* === FCFS 計算 === */
-    int fcfs_accepted = 0, fcfs_rejected = 0;
-    int fcfs_earliest = 32, fcfs_latest = 0;
-    double fcfs_parking_sum = 0.0, fcfs_battery_sum = 0.0, fcfs_cable_sum = 0.0;
-    double fcfs_locker_sum = 0.0, fcfs_umbrella_sum = 0.0, fcfs_valet_sum = 0.0, fcfs_inflation_sum = 0.0;
-    for (i = 0; i < total; i++) {
-        if (bookings[i].accepted) {
-            fcfs_accepted++;
-            int d = atoi(bookings[i].date + 8); // 取日期中的 "DD" 部分
-            if (d < fcfs_earliest) fcfs_earliest = d;
-            if (d > fcfs_latest) fcfs_latest = d;
-            if (bookings[i].requires_parking)
-                fcfs_parking_sum += bookings[i].duration;
-            if ((strlen(bookings[i].essential1) > 0 && strcmp(bookings[i].essential1, "battery") == 0) ||
-                (strlen(bookings[i].essential2) > 0 && strcmp(bookings[i].essential2, "battery") == 0) ||
-                (strlen(bookings[i].essential3) > 0 && strcmp(bookings[i].essential3, "battery") == 0))
-                fcfs_battery_sum += bookings[i].duration;
-            if (strlen(bookings[i].essential2) > 0 && strcmp(bookings[i].essential2, "cable") == 0)
-                fcfs_cable_sum += bookings[i].duration;
-            if (strlen(bookings[i].essential1) > 0 && strcmp(bookings[i].essential1, "locker") == 0)
-                fcfs_locker_sum += bookings[i].duration;
-            if (strlen(bookings[i].essential2) > 0 && strcmp(bookings[i].essential2, "umbrella") == 0)
-                fcfs_umbrella_sum += bookings[i].duration;
-            if (strlen(bookings[i].essential3) > 0 && strcmp(bookings[i].essential3, "valetPark") == 0)
-                fcfs_valet_sum += bookings[i].duration;
-            if ((strlen(bookings[i].essential1) > 0 && strcmp(bookings[i].essential1, "inflationService") == 0) ||
-                (strlen(bookings[i].essential2) > 0 && strcmp(bookings[i].essential2, "inflationService") == 0) ||
-                (strlen(bookings[i].essential3) > 0 && strcmp(bookings[i].essential3, "inflationService") == 0))
-                fcfs_inflation_sum += bookings[i].duration;
-        } else {
-            fcfs_rejected++;
-        }
-    }
-    int fcfs_days = fcfs_latest - fcfs_earliest + 1;
-    if (fcfs_days <= 0) fcfs_days = 1;
-    double fcfs_parking_available = PARKING_CAPACITY * fcfs_days * available_hours_per_day;
-    double fcfs_essential_available = ESSENTIAL_CAPACITY * fcfs_days * available_hours_per_day;
-    double fcfs_parking_util = (fcfs_parking_sum / fcfs_parking_available) * 100.0;
-    double fcfs_battery_util = (fcfs_battery_sum / fcfs_essential_available) * 100.0;
-    double fcfs_cable_util = (fcfs_cable_sum / fcfs_essential_available) * 100.0;
-    double fcfs_locker_util = (fcfs_locker_sum / fcfs_essential_available) * 100.0;
-    double fcfs_umbrella_util = (fcfs_umbrella_sum / fcfs_essential_available) * 100.0;
-    double fcfs_valet_util = (fcfs_valet_sum / fcfs_essential_available) * 100.0;
-    double fcfs_inflation_util = (fcfs_inflation_sum / fcfs_essential_available) * 100.0;
-
-    /* === PRIO 模擬計算 === */
-    Booking prio_bookings[MAX_BOOKINGS];
-    simulate_PRIO(bookings, prio_bookings, total);
-    int prio_accepted = 0, prio_rejected = 0;
-    int prio_earliest = 32, prio_latest = 0;
-    double prio_parking_sum = 0.0, prio_battery_sum = 0.0, prio_cable_sum = 0.0;
-    double prio_locker_sum = 0.0, prio_umbrella_sum = 0.0, prio_valet_sum = 0.0, prio_inflation_sum = 0.0;
-    for (i = 0; i < total; i++) {
-        if (prio_bookings[i].accepted) {
-            prio_accepted++;
-            int d = atoi(prio_bookings[i].date + 8);
-            if (d < prio_earliest) prio_earliest = d;
-            if (d > prio_latest) prio_latest = d;
-            if (prio_bookings[i].requires_parking)
-                prio_parking_sum += prio_bookings[i].duration;
-            if ((strlen(prio_bookings[i].essential1) > 0 && strcmp(prio_bookings[i].essential1, "battery") == 0) ||
-                (strlen(prio_bookings[i].essential2) > 0 && strcmp(prio_bookings[i].essential2, "battery") == 0) ||
-                (strlen(prio_bookings[i].essential3) > 0 && strcmp(prio_bookings[i].essential3, "battery") == 0))
-                prio_battery_sum += prio_bookings[i].duration;
-            if (strlen(prio_bookings[i].essential2) > 0 && strcmp(prio_bookings[i].essential2, "cable") == 0)
-                prio_cable_sum += prio_bookings[i].duration;
-            if (strlen(prio_bookings[i].essential1) > 0 && strcmp(prio_bookings[i].essential1, "locker") == 0)
-                prio_locker_sum += prio_bookings[i].duration;
-            if (strlen(prio_bookings[i].essential2) > 0 && strcmp(prio_bookings[i].essential2, "umbrella") == 0)
-                prio_umbrella_sum += prio_bookings[i].duration;
-            if (strlen(prio_bookings[i].essential3) > 0 && strcmp(prio_bookings[i].essential3, "valetPark") == 0)
-                prio_valet_sum += prio_bookings[i].duration;
-            if ((strlen(prio_bookings[i].essential1) > 0 && strcmp(prio_bookings[i].essential1, "inflationService") == 0) ||
-                (strlen(prio_bookings[i].essential2) > 0 && strcmp(prio_bookings[i].essential2, "inflationService") == 0) ||
-                (strlen(prio_bookings[i].essential3) > 0 && strcmp(prio_bookings[i].essential3, "inflationService") == 0))
-                prio_inflation_sum += prio_bookings[i].duration;
-        } else {
-            prio_rejected++;
-        }
-    }
-    int prio_days = prio_latest - prio_earliest + 1;
-    if (prio_days <= 0) prio_days = 1;
-    double prio_parking_available = PARKING_CAPACITY * prio_days * available_hours_per_day;
-    double prio_essential_available = ESSENTIAL_CAPACITY * prio_days * available_hours_per_day;
-    double prio_parking_util = (prio_parking_sum / prio_parking_available) * 100.0;
-    double prio_battery_util = (prio_battery_sum / prio_essential_available) * 100.0;
-    double prio_cable_util = (prio_cable_sum / prio_essential_available) * 100.0;
-    double prio_locker_util = (prio_locker_sum / prio_essential_available) * 100.0;
-    double prio_umbrella_util = (prio_umbrella_sum / prio_essential_available) * 100.0;
-    double prio_valet_util = (prio_valet_sum / prio_essential_available) * 100.0;
-    double prio_inflation_util = (prio_inflation_sum / prio_essential_available) * 100.0;
-
-    /* === OPTI 模擬計算 === */
-    Booking opti_bookings[MAX_BOOKINGS];
-    simulate_OPTI(bookings, opti_bookings, total);
-    int opti_accepted = 0, opti_rejected = 0;
-    int opti_earliest = 32, opti_latest = 0;
-    double opti_parking_sum = 0.0, opti_battery_sum = 0.0, opti_cable_sum = 0.0;
-    double opti_locker_sum = 0.0, opti_umbrella_sum = 0.0, opti_valet_sum = 0.0, opti_inflation_sum = 0.0;
-    for (i = 0; i < total; i++) {
-        if (opti_bookings[i].accepted) {
-            opti_accepted++;
-            int d = atoi(opti_bookings[i].date + 8);
-            if (d < opti_earliest) opti_earliest = d;
-            if (d > opti_latest) opti_latest = d;
-            if (opti_bookings[i].requires_parking)
-                opti_parking_sum += opti_bookings[i].duration;
-            if ((strlen(opti_bookings[i].essential1) > 0 && strcmp(opti_bookings[i].essential1, "battery") == 0) ||
-                (strlen(opti_bookings[i].essential2) > 0 && strcmp(opti_bookings[i].essential2, "battery") == 0) ||
-                (strlen(opti_bookings[i].essential3) > 0 && strcmp(opti_bookings[i].essential3, "battery") == 0))
-                opti_battery_sum += opti_bookings[i].duration;
-            if (strlen(opti_bookings[i].essential2) > 0 && strcmp(opti_bookings[i].essential2, "cable") == 0)
-                opti_cable_sum += opti_bookings[i].duration;
-            if (strlen(opti_bookings[i].essential1) > 0 && strcmp(opti_bookings[i].essential1, "locker") == 0)
-                opti_locker_sum += opti_bookings[i].duration;
-            if (strlen(opti_bookings[i].essential2) > 0 && strcmp(opti_bookings[i].essential2, "umbrella") == 0)
-                opti_umbrella_sum += opti_bookings[i].duration;
-            if (strlen(opti_bookings[i].essential3) > 0 && strcmp(opti_bookings[i].essential3, "valetPark") == 0)
-                opti_valet_sum += opti_bookings[i].duration;
-            if ((strlen(opti_bookings[i].essential1) > 0 && strcmp(opti_bookings[i].essential1, "inflationService") == 0) ||
-                (strlen(opti_bookings[i].essential2) > 0 && strcmp(opti_bookings[i].essential2, "inflationService") == 0) ||
-                (strlen(opti_bookings[i].essential3) > 0 && strcmp(opti_bookings[i].essential3, "inflationService") == 0))
-                opti_inflation_sum += opti_bookings[i].duration;
-        } else {
-            opti_rejected++;
-        }
-    }
-    int opti_days = opti_latest - opti_earliest + 1;
-    if (opti_days <= 0) opti_days = 1;
-    double opti_parking_available = PARKING_CAPACITY * opti_days * available_hours_per_day;
-    double opti_essential_available = ESSENTIAL_CAPACITY * opti_days * available_hours_per_day;
-    double opti_parking_util = (opti_parking_sum / opti_parking_available) * 100.0;
-    double opti_battery_util = (opti_battery_sum / opti_essential_available) * 100.0;
-    double opti_cable_util = (opti_cable_sum / opti_essential_available) * 100.0;
-    double opti_locker_util = (opti_locker_sum / opti_essential_available) * 100.0;
-    double opti_umbrella_util = (opti_umbrella_sum / opti_essential_available) * 100.0;
-    double opti_valet_util = (opti_valet_sum / opti_essential_available) * 100.0;
-    double opti_inflation_util = (opti_inflation_sum / opti_essential_available) * 100.0;
-
-    /* === 使用 pipe 與 fork 輸出綜合報告 === */
-    int pipefd[2];
-    pid_t pid;
-    char outBuffer[1024];
-    int nBytes;
-    if (pipe(pipefd) == -1) {
-        perror("pipe");
-        return;
-    }
-    pid = fork();
-    if (pid < 0) {
-        perror("fork");
+    if (json) {
+        printf("{\"bookings\":{\"received\":%d,\"accepted\":%d,\"rejected\":%d,\"preempted\":%d},\"latency\":[",
+               snap.count, snap.fcfs.accepted, snap.fcfs.rejected, preempted);
+        for (stat = 0; stat < STAT_COUNT; stat++) {
+            const LatencyHistogram *h = &latency[stat];
+            printf("%s{\"name\":\"%s\",\"count\":%ld,\"total_us\":%.1f,\"max_us\":%.1f,\"buckets\":[",
+                   stat > 0 ? "," : "", h->name, h->count, h->totalUs, h->maxUs);
+            for (k = 0; k < LATENCY_BUCKETS; k++)
+                printf("%s%ld", k > 0 ? "," : "", h->buckets[k]);
+            printf("]}");
+        }
+        printf("]}\n");
         return;
     }
-    if (pid == 0) {  /* 子行程：讀取 pipe 並印出 */
-        close(pipefd[1]);
-        while ((nBytes = read(pipefd[0], outBuffer, sizeof(outBuffer)-1)) > 0) {
-            outBuffer[nBytes] = '\0';
-            printf("%s", outBuffer);
-        }
-        close(pipefd[0]);
-        exit(0);
-    } else {  /* 父行程：將報告內容寫入 pipe */
-        close(pipefd[0]);
-        sprintf(outBuffer, "\n** Parking Booking Manager – Summary Report **\n\n");
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-
-        sprintf(outBuffer, "\nPerformance:\n\n");
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-
-        /* FCFS 報告 */
-        sprintf(outBuffer, "For FCFS:\n");
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Total Number of Bookings Received: %d\n", total);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Number of Bookings Assigned: %d (%.1f%%)\n", fcfs_accepted, total > 0 ? (fcfs_accepted * 100.0 / total) : 0.0);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Number of Bookings Rejected: %d (%.1f%%)\n", fcfs_rejected, total > 0 ? (fcfs_rejected * 100.0 / total) : 0.0);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Utilization of Time Slot:\n");
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Parking: %.1f%%\n", fcfs_parking_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Battery: %.1f%%\n", fcfs_battery_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Cable: %.1f%%\n", fcfs_cable_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Locker: %.1f%%\n", fcfs_locker_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Umbrella: %.1f%%\n", fcfs_umbrella_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Valet Parking: %.1f%%\n", fcfs_valet_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Inflation Service: %.1f%%\n\n", fcfs_inflation_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-
-        /* PRIO 報告 */
-        sprintf(outBuffer, "For PRIO:\n");
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Total Number of Bookings Received: %d\n", total);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Number of Bookings Assigned: %d (%.1f%%)\n", prio_accepted, total > 0 ? (prio_accepted * 100.0 / total) : 0.0);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Number of Bookings Rejected: %d (%.1f%%)\n", prio_rejected, total > 0 ? (prio_rejected * 100.0 / total) : 0.0);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Utilization of Time Slot:\n");
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Parking: %.1f%%\n", prio_parking_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Battery: %.1f%%\n", prio_battery_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Cable: %.1f%%\n", prio_cable_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Locker: %.1f%%\n", prio_locker_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Umbrella: %.1f%%\n", prio_umbrella_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Valet Parking: %.1f%%\n", prio_valet_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Inflation Service: %.1f%%\n\n", prio_inflation_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-
-        /* OPTI 報告 */
-        sprintf(outBuffer, "For OPTI:\n");
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Total Number of Bookings Received: %d\n", total);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Number of Bookings Assigned: %d (%.1f%%)\n", opti_accepted, total > 0 ? (opti_accepted * 100.0 / total) : 0.0);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Number of Bookings Rejected: %d (%.1f%%)\n", opti_rejected, total > 0 ? (opti_rejected * 100.0 / total) : 0.0);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "  Utilization of Time Slot:\n");
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Parking: %.1f%%\n", opti_parking_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Battery: %.1f%%\n", opti_battery_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Cable: %.1f%%\n", opti_cable_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Locker: %.1f%%\n", opti_locker_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Umbrella: %.1f%%\n", opti_umbrella_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Valet Parking: %.1f%%\n", opti_valet_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        sprintf(outBuffer, "    Inflation Service: %.1f%%\n\n", opti_inflation_util);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
 
-        close(pipefd[1]);
-        wait(NULL);
-        printf("-> [Done!]\n");
+    printf("\n** Parking Booking Manager – Statistics **\n\n");
+    printf("Bookings received: %d (FCFS accepted %d, rejected %d)\n", snap.count, snap.fcfs.accepted, snap.fcfs.rejected);
+    if (preempted >= 0)
+        printf("Bookings preempted by PRIO: %d\n\n", preempted);
+    else
+        printf("Bookings preempted by PRIO: - (PRIO not scheduled since the last booking)\n\n");
+    printf("%-26s %8s %10s %10s %10s %10s\n", "Latency (us)", "Count", "Mean", "p50 <=", "p99 <=", "Max");
+    printf("===========================================================================\n");
+    for (stat = 0; stat < STAT_COUNT; stat++) {
+        const LatencyHistogram *h = &latency[stat];
+        if (h->count == 0)
+            continue;
+        printf("%-26s %8ld %10.1f %10.0f %10.0f %10.1f\n", h->name, h->count, h->totalUs / h->count,
+               latency_quantile(h, 0.5), latency_quantile(h, 0.99), h->maxUs);
     }
+    printf("===========================================================================\n");
+    printf("-> [Done!]\n");
 }
 
-
 /* 根據使用者輸入的命令進行處理 */
 void process_command(char *line) {
     char commandCopy[MAX_LINE_LENGTH];
     char *token;
+    int stat = -1;
+    double start = now_ms();
     strcpy(commandCopy, line);
     token = strtok(commandCopy, " ");
     if (token == NULL)
         return;
-    if (strcmp(token, "addParking") == 0)
+    if (strcmp(token, "addParking") == 0) {
         process_addParking(line);
-    else if (strcmp(token, "addReservation") == 0)
+        stat = STAT_ADD_PARKING;
+    }
+    else if (strcmp(token, "addReservation") == 0) {
         process_addReservation(line);
-    else if (strcmp(token, "addEvent") == 0)
+        stat = STAT_ADD_RESERVATION;
+    }
+    else if (strcmp(token, "addEvent") == 0) {
         process_addEvent(line);
-    else if (strcmp(token, "bookEssentials") == 0)
+        stat = STAT_ADD_EVENT;
+    }
+    else if (strcmp(token, "bookEssentials") == 0) {
         process_bookEssentials(line);
-    else if (strcmp(token, "addBatch") == 0)
+        stat = STAT_BOOK_ESSENTIALS;
+    }
+    else if (strcmp(token, "addBatch") == 0) {
         process_addBatch(line);
+        stat = STAT_ADD_BATCH;
+    }
+    else if (strcmp(token, "setOPTI") == 0) {
+        process_setOPTI(line);
+        stat = STAT_SET_OPTI;
+    }
+    else if (strcmp(token, "printStats") == 0 || strcmp(token, "printStats;") == 0) {
+        process_printStats(line);
+        stat = STAT_PRINT_STATS;
+    }
     else if (strcmp(token, "printBookings") == 0) {
         token = strtok(NULL, " ");
+        stat = STAT_PRINT_BOOKINGS;
         if (token != NULL) {
             char norm[20];
             strcpy(norm, normalize_member(token));
             if (strcmp(norm, "ALL;") == 0 || strcmp(norm, "ALL") == 0){
                 process_printSummary();
+                stat = STAT_PRINT_SUMMARY;
+            }
+            else if (strcmp(norm, "OPTI") == 0 || strcmp(norm, "OPTI;") == 0) {
+                process_printOptimized("OPTI", &optiCache, simulate_OPTI);
+                stat = STAT_PRINT_OPTI;
+            }
+            else if (strcmp(norm, "OPTI_EXACT") == 0 || strcmp(norm, "OPTI_EXACT;") == 0) {
+                process_printOptimized("OPTI_EXACT", &exactCache, simulate_OPTI_EXACT);
+                stat = STAT_PRINT_OPTI_EXACT;
             }
-            else if (strcmp(norm, "OPTI") == 0 || strcmp(norm, "OPTI;") == 0)
-                process_printOptimized();
             else
                 process_printBookings(line);
         } else {
@@ -1085,240 +3420,543 @@ void process_command(char *line) {
     }
     else if (strncmp(token, "endProgram", 10) == 0) {
         printf("Bye!\n");
-        exit(0);
+        endRequested = 1;
     }
     else {
         printf("Unknown command.\n");
     }
+    if (stat >= 0)
+        latency_record(stat, start);
+    journal_commit();
+}
+
+/* setOPTI [-days N] [-cost C] [-budget MS] [-workers W]
+   允許 OPTI 將預約移往前後 N 日（0 = 只在原日期內調整），C 為每移動一日的成本，
+   以同日移動的小時數計算；MS 為 OPTI_EXACT 的時間預算上限（毫秒）；
+   W 為 OPTI 依日期分工的子行程數目（0 = 每個 CPU 一個，結果不受影響） */
+void process_setOPTI(char *line) {
+    char *option, *value;
+    int days = optiDays, budget = exactBudgetMs, workers = optiWorkers;
+    double cost = optiDayCost;
+    while ((option = strtok(NULL, " ;\n")) != NULL) {
+        value = strtok(NULL, " ;\n");
+        option = normalize_member(option);
+        if (value != NULL && strcmp(option, "days") == 0)
+            days = atoi(value);
+        else if (value != NULL && strcmp(option, "cost") == 0)
+            cost = atof(value);
+        else if (value != NULL && strcmp(option, "budget") == 0)
+            budget = atoi(value);
+        else if (value != NULL && strcmp(option, "workers") == 0)
+            workers = atoi(value);
+        else {
+            printf("Error: Usage: setOPTI -days N -cost C -budget MS -workers W\n");
+            return;
+        }
+    }
+    if (days < 0 || days > MAX_OPTI_DAYS || cost < 0.0 || budget < 0 ||
+        workers < 0 || workers > MAX_OPTI_WORKERS) {
+        printf("Error: OPTI days must be 0-%d, workers 0-%d, cost and budget must not be negative\n",
+               MAX_OPTI_DAYS, MAX_OPTI_WORKERS);
+        return;
+    }
+    if (days != optiDays || cost != optiDayCost)
+        cache_clear(&optiCache);
+    if (budget != exactBudgetMs)
+        cache_clear(&exactCache);
+    optiDays = days;
+    optiDayCost = cost;
+    exactBudgetMs = budget;
+    optiWorkers = workers;
+    printf("-> OPTI searches +/-%d day(s), cost %.1f per day moved; OPTI_EXACT budget %d ms\n",
+           optiDays, optiDayCost, exactBudgetMs);
 }
 
 /* Process the optimized scheduling in independent simulation:
-   與 process_printSummary 中的 OPTI 模擬類似，但單獨輸出模擬結果
+   與 process_printSummary 中的 OPTI / OPTI_EXACT 模擬類似，但單獨輸出模擬結果
 */
-void process_printOptimized(void) {
-    int i;
-    Booking temp_bookings[MAX_BOOKINGS];
-    simulate_OPTI(bookings, temp_bookings, bookingCount);
-    
-    int pipefd[2];
-    pid_t pid;
+void process_printOptimized(const char *algorithm, ScheduleCache *c, void (*simulate)(Schedule *)) {
+    const Schedule *sched;
+    const ScheduleCache *cache;
+    Snapshot snap;
+    double outputStart;
+    int *memberIdx;
+    MemberGroups groups;
     char outBuffer[1024];
-    int i2, n;
-    char algorithm[10] = "OPTI";
-    
-    if (pipe(pipefd) == -1) {
-        perror("pipe");
-        return;
-    }
-    pid = fork();
-    if (pid < 0) {
-        perror("fork");
+    int i2;
+
+    snapshot_take(&snap);
+    cache = cached_schedule(c, simulate, &snap);
+    memberIdx = (int *)malloc(sizeof(int) * (size_t)(snap.count > 0 ? snap.count : 1));
+    if (memberIdx == NULL || cache == NULL || !group_by_member(&cache->sched, 0, memberIdx, &groups)) {
+        free(memberIdx);
+        printf("Error: Out of memory\n");
         return;
     }
-    if (pid == 0) {
-        close(pipefd[1]);
-        while ((n = read(pipefd[0], outBuffer, sizeof(outBuffer)-1)) > 0) {
-            outBuffer[n] = '\0';
-            printf("%s", outBuffer);
-        }
-        close(pipefd[0]);
-        exit(0);
-    } else {
-        close(pipefd[0]);
-        sprintf(outBuffer, "\n** Parking Booking – ACCEPTED / %s **\n", algorithm);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        {
-            char *members[] = {"member_A", "member_B", "member_C", "member_D", "member_E"};
-            int numMembers = 5;
-            int foundAnyAccepted = 0;
-            int j, k;
-            for (i2 = 0; i2 < numMembers; i2++) {
-                int count = 0;
-                Booking *memberBookings[MAX_BOOKINGS];
-                int memberCount = 0;
-                for (j = 0; j < bookingCount; j++) {
-                    if (temp_bookings[j].accepted && strcmp(temp_bookings[j].member, members[i2]) == 0) {
-                        memberBookings[memberCount++] = &temp_bookings[j];
-                        count++;
-                    }
-                }
-                if (count > 0) {
-                    foundAnyAccepted = 1;
-                    sprintf(outBuffer, "%s has the following bookings:\n", members[i2]);
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    sprintf(outBuffer, "Date       Start End   Type         Device\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    sprintf(outBuffer, "===========================================================================\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    for (k = 0; k < memberCount; k++) {
-                        int hour, minute;
-                        sscanf(memberBookings[k]->time, "%d:%d", &hour, &minute);
-                        int endHour = hour + (int)(memberBookings[k]->duration);
-                        char endTime[6];
-                        sprintf(endTime, "%02d:%02d", endHour, minute);
-                        char typeStr[20];
-                        if (strcmp(memberBookings[k]->type, "Essentials") == 0)
-                            strcpy(typeStr, "*");
-                        else
-                            strcpy(typeStr, memberBookings[k]->type);
+    sched = &cache->sched;
+    
+    outputStart = now_ms();
+    sprintf(outBuffer, "\n** Parking Booking – ACCEPTED / %s **\n", algorithm);
+    report_append(&report, outBuffer, strlen(outBuffer));
+    {
+        int foundAnyAccepted = 0;
+        int k;
+        for (i2 = 0; i2 < groups.memberCount; i2++) {
+            const char *member = memberTable.names[groups.members[i2]];
+            int *group = memberIdx + groups.first[i2];
+            int count = groups.first[i2 + 1] - groups.first[i2];
+            int memberCount = count;
+            if (count > 0) {
+                foundAnyAccepted = 1;
+                snprintf(outBuffer, sizeof(outBuffer), "%s has the following bookings:\n", member);
+                report_append(&report, outBuffer, strlen(outBuffer));
+                sprintf(outBuffer, "Date       Start End   Type         Device\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+                sprintf(outBuffer, "===========================================================================\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+                for (k = 0; k < memberCount; k++) {
+                    Booking *bk = booking_at(group[k]);
+                    char dateStr[16], startTime[16], endTime[16];
+                    schedule_times(sched, group[k], startTime, endTime);
+                    char typeStr[20];
+                    snprintf(typeStr, sizeof(typeStr), "%s",
+                             bk->type == TYPE_ESSENTIALS ? "*" : typeNames[bk->type]);
+                    {
+                        char deviceStr[100];
+                        device_list(bk, 3, "*", deviceStr, sizeof(deviceStr));
                         {
-                            char deviceStr[100];
-                            deviceStr[0] = '\0';
-                            if (strcmp(memberBookings[k]->type, "Essentials") == 0) {
-                                if (strlen(memberBookings[k]->essential1) > 0)
-                                    strcpy(deviceStr, memberBookings[k]->essential1);
-                                else
-                                    strcpy(deviceStr, "*");
-                            } else {
-                                if (strlen(memberBookings[k]->essential1) > 0)
-                                    strcpy(deviceStr, memberBookings[k]->essential1);
-                                if (strlen(memberBookings[k]->essential2) > 0) {
-                                    if (strlen(deviceStr) > 0) {
-                                        strcat(deviceStr, " ");
-                                        strcat(deviceStr, memberBookings[k]->essential2);
-                                    } else {
-                                        strcpy(deviceStr, memberBookings[k]->essential2);
-                                    }
-                                }
-                                if (strlen(memberBookings[k]->essential3) > 0) {
-                                    if (strlen(deviceStr) > 0) {
-                                        strcat(deviceStr, " ");
-                                        strcat(deviceStr, memberBookings[k]->essential3);
-                                    } else {
-                                        strcpy(deviceStr, memberBookings[k]->essential3);
-                                    }
-                                }
-                                if (strlen(deviceStr) == 0)
-                                    strcpy(deviceStr, "*");
-                            }
-                            {
-                                char bookingLine[256];
-                                sprintf(bookingLine, "%-10s %-5s %-5s %-12s %s\n",
-                                        memberBookings[k]->date,
-                                        memberBookings[k]->time,
-                                        endTime,
-                                        typeStr,
-                                        deviceStr);
-                                write(pipefd[1], bookingLine, strlen(bookingLine));
-                            }
+                            char bookingLine[256];
+                            snprintf(bookingLine, sizeof(bookingLine), "%-10s %-5s %-5s %-12s %s\n",
+                                    format_date(schedule_date(sched, group[k]), dateStr),
+                                    startTime,
+                                    endTime,
+                                    typeStr,
+                                    deviceStr);
+                            report_append(&report, bookingLine, strlen(bookingLine));
                         }
                     }
-                    
-                    sprintf(outBuffer, "\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
                 }
+                
+                sprintf(outBuffer, "\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
             }
-            if (foundAnyAccepted) {
-                sprintf(outBuffer, "- End -\n");
-                write(pipefd[1], outBuffer, strlen(outBuffer));
-            } else {
-                sprintf(outBuffer, "No accepted bookings.\n");
-                write(pipefd[1], outBuffer, strlen(outBuffer));
-            }
-            sprintf(outBuffer, "===========================================================================\n");
-            write(pipefd[1], outBuffer, strlen(outBuffer));
-        }
-        
-        /* --- Print Rejected Bookings --- */
-        sprintf(outBuffer, "\n** Parking Booking – REJECTED / %s **\n", algorithm);
-        write(pipefd[1], outBuffer, strlen(outBuffer));
-        {
-            char *members[] = {"member_A", "member_B", "member_C", "member_D", "member_E"};
-            int numMembers = 5;
-            int foundAnyRejected = 0;
-            int j, k;
-            for (i2 = 0; i2 < numMembers; i2++) {
-                int count = 0;
-                Booking *memberBookings[MAX_BOOKINGS];
-                int memberCount = 0;
-                for (j = 0; j < bookingCount; j++) {
-                    if (!temp_bookings[j].accepted && strcmp(temp_bookings[j].member, members[i2]) == 0) {
-                        memberBookings[memberCount++] = &temp_bookings[j];
-                        count++;
-                    }
-                }
-                if (count > 0) {
-                    foundAnyRejected = 1;
-                    sprintf(outBuffer, "%s (there are %d bookings rejected):\n", members[i2], count);
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    sprintf(outBuffer, "Date       Start End   Type         Essentials\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    sprintf(outBuffer, "===========================================================================\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
-                    for (k = 0; k < memberCount; k++) {
-                        int hour, minute;
-                        sscanf(memberBookings[k]->time, "%d:%d", &hour, &minute);
-                        int endHour = hour + (int)(memberBookings[k]->duration);
-                        char endTime[6];
-                        sprintf(endTime, "%02d:%02d", endHour, minute);
-                        char typeStr[20];
-                        strcpy(typeStr, memberBookings[k]->type);
+        }
+        if (foundAnyAccepted) {
+            sprintf(outBuffer, "- End -\n");
+            report_append(&report, outBuffer, strlen(outBuffer));
+        } else {
+            sprintf(outBuffer, "No accepted bookings.\n");
+            report_append(&report, outBuffer, strlen(outBuffer));
+        }
+        sprintf(outBuffer, "===========================================================================\n");
+        report_append(&report, outBuffer, strlen(outBuffer));
+    }
+    
+    /* --- Print Rejected Bookings --- */
+    sprintf(outBuffer, "\n** Parking Booking – REJECTED / %s **\n", algorithm);
+    report_append(&report, outBuffer, strlen(outBuffer));
+    {
+        int foundAnyRejected = 0;
+        int k;
+        for (i2 = 0; i2 < groups.memberCount; i2++) {
+            const char *member = memberTable.names[groups.members[i2]];
+            int *group = memberIdx + groups.first[groups.memberCount + i2];
+            int count = groups.first[groups.memberCount + i2 + 1] - groups.first[groups.memberCount + i2];
+            int memberCount = count;
+            if (count > 0) {
+                foundAnyRejected = 1;
+                snprintf(outBuffer, sizeof(outBuffer), "%s (there are %d bookings rejected):\n", member, count);
+                report_append(&report, outBuffer, strlen(outBuffer));
+                sprintf(outBuffer, "Date       Start End   Type         Essentials\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+                sprintf(outBuffer, "===========================================================================\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
+                for (k = 0; k < memberCount; k++) {
+                    Booking *bk = booking_at(group[k]);
+                    char dateStr[16], startTime[16], endTime[16];
+                    schedule_times(sched, group[k], startTime, endTime);
+                    char typeStr[20];
+                    snprintf(typeStr, sizeof(typeStr), "%s", typeNames[bk->type]);
+                    {
+                        char essStr[100];
+                        device_list(bk, 3, "-", essStr, sizeof(essStr));
                         {
-                            char essStr[100];
-                            essStr[0] = '\0';
-                            if (strcmp(memberBookings[k]->type, "Essentials") == 0) {
-                                if (strlen(memberBookings[k]->essential1) > 0)
-                                    strcpy(essStr, memberBookings[k]->essential1);
-                                else
-                                    strcpy(essStr, "-");
-                            } else {
-                                if (strlen(memberBookings[k]->essential1) > 0)
-                                    strcpy(essStr, memberBookings[k]->essential1);
-                                if (strlen(memberBookings[k]->essential2) > 0) {
-                                    if (strlen(essStr) > 0) {
-                                        strcat(essStr, " ");
-                                        strcat(essStr, memberBookings[k]->essential2);
-                                    } else {
-                                        strcpy(essStr, memberBookings[k]->essential2);
-                                    }
-                                }
-                                if (strlen(memberBookings[k]->essential3) > 0) {
-                                    if (strlen(essStr) > 0) {
-                                        strcat(essStr, " ");
-                                        strcat(essStr, memberBookings[k]->essential3);
-                                    } else {
-                                        strcpy(essStr, memberBookings[k]->essential3);
-                                    }
-                                }
-                                if (strlen(essStr) == 0)
-                                    strcpy(essStr, "-");
-                            }
-                            {
-                                char bookingLine[256];
-                                sprintf(bookingLine, "%-10s %-5s %-5s %-12s %s\n",
-                                        memberBookings[k]->date,
-                                        memberBookings[k]->time,
-                                        endTime,
-                                        typeStr,
-                                        essStr);
-                                write(pipefd[1], bookingLine, strlen(bookingLine));
-                            }
+                            char bookingLine[256];
+                            snprintf(bookingLine, sizeof(bookingLine), "%-10s %-5s %-5s %-12s %s\n",
+                                    format_date(schedule_date(sched, group[k]), dateStr),
+                                    startTime,
+                                    endTime,
+                                    typeStr,
+                                    essStr);
+                            report_append(&report, bookingLine, strlen(bookingLine));
                         }
                     }
-                    sprintf(outBuffer, "\n");
-                    write(pipefd[1], outBuffer, strlen(outBuffer));
                 }
+                sprintf(outBuffer, "\n");
+                report_append(&report, outBuffer, strlen(outBuffer));
             }
-            if (foundAnyRejected) {
-                sprintf(outBuffer, "- End -\n");
-                write(pipefd[1], outBuffer, strlen(outBuffer));
+        }
+        if (foundAnyRejected) {
+            sprintf(outBuffer, "- End -\n");
+            report_append(&report, outBuffer, strlen(outBuffer));
+        } else {
+            sprintf(outBuffer, "No rejected bookings.\n");
+            report_append(&report, outBuffer, strlen(outBuffer));
+        }
+        sprintf(outBuffer, "===========================================================================\n");
+        report_append(&report, outBuffer, strlen(outBuffer));
+    }
+    
+    report_send(&report);
+    latency_record(STAT_REPORT_OUTPUT, outputStart);
+    free(memberIdx);
+    free(groups.first);
+    printf("-> [Done!]\n");
+}
+
+/* 伺服器模式的 printBookings：在子行程中產生報告並直接回應客戶端，子行程的
+   copy-on-write 記憶體即報告的快照，本行程得以繼續收錄其他客戶端的預約。
+   子行程新算出的排程及延遲統計經 pipe 傳回，由 report_finish 收回。
+   無法建立子行程時回傳 0，由呼叫者直接執行 */
+int report_start(Client *c, char *line) {
+    ReportResult r;
+    int known[REPORT_CACHES];
+    int pipefd[2], k;
+    pid_t pid;
+    if (reportWorkers >= MAX_REPORT_WORKERS || pipe(pipefd) == -1)
+        return 0;
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return 0;
+    }
+    if (pid == 0) {  /* 子行程：不寫日誌，只記錄本次報告的延遲 */
+        close(pipefd[0]);
+        journal.fd = -1;
+        journal.used = 0;
+        if (reportLock == NULL)
+            reporterSock = -1;
+        for (k = 0; k < STAT_COUNT; k++) {
+            const char *name = latency[k].name;
+            memset(&latency[k], 0, sizeof(latency[k]));
+            latency[k].name = name;
+        }
+        for (k = 0; k < REPORT_CACHES; k++)
+            known[k] = reportCaches[k]->valid && reportCaches[k]->generation == store.generation;
+        if (dup2(c->fd, STDOUT_FILENO) < 0)
+            _exit(1);
+        process_command(line);
+        fflush(stdout);
+        write_all(STDOUT_FILENO, "", 1);
+        for (k = 0; k < REPORT_CACHES; k++) {
+            const ScheduleCache *cache = reportCaches[k];
+            if (known[k] || !cache->valid || cache->generation != store.generation)
+                continue;
+            r.cache = k;
+            r.count = cache->sched.count;
+            r.generation = cache->generation;
+            r.epoch = cache->epoch;
+            r.stats = cache->stats;
+            if (!write_all(pipefd[1], &r, sizeof(r)) ||
+                !write_all(pipefd[1], cache->sched.accepted, (size_t)r.count) ||
+                !write_all(pipefd[1], cache->sched.startSlot, sizeof(short) * (size_t)r.count) ||
+                !write_all(pipefd[1], cache->sched.dayShift, sizeof(short) * (size_t)r.count))
+                _exit(1);
+        }
+        memset(&r, 0, sizeof(r));
+        r.cache = -1;
+        if (!write_all(pipefd[1], &r, sizeof(r)) || !write_all(pipefd[1], latency, sizeof(latency)))
+            _exit(1);
+        _exit(0);
+    }
+    close(pipefd[1]);
+    c->reportPid = pid;
+    c->reportFd = pipefd[0];
+    reportWorkers++;
+    return 1;
+}
+
+/* 略過 pipe 中 len 個位元組 */
+static int read_skip(int fd, size_t len) {
+    char buffer[4096];
+    size_t n;
+    while (len > 0) {
+        n = len < sizeof(buffer) ? len : sizeof(buffer);
+        if (!read_all(fd, buffer, n))
+            return 0;
+        len -= n;
+    }
+    return 1;
+}
+
+/* 收回報告子行程的結果：排程只在仍對應目前的預約資料（generation 相同）且其後
+   未曾因 setOPTI 清除快取（epoch 相同）時存入快取；延遲統計併入本行程 */
+void report_finish(Client *c) {
+    ReportResult r;
+    LatencyHistogram child[STAT_COUNT];
+    ScheduleCache *cache;
+    Schedule sched;
+    size_t len;
+    int k, j, end = 0;
+    while (read_all(c->reportFd, &r, sizeof(r))) {
+        if (r.cache < 0 || r.cache >= REPORT_CACHES) {
+            end = r.cache == -1;
+            break;
+        }
+        cache = reportCaches[r.cache];
+        len = (size_t)r.count * (1 + 2 * sizeof(short));
+        if (r.generation != store.generation || r.count != store.count || r.epoch != cache->epoch ||
+            (cache->valid && cache->generation == r.generation) || !schedule_init(&sched, r.count)) {
+            if (!read_skip(c->reportFd, len))
+                break;
+            continue;
+        }
+        if (!read_all(c->reportFd, sched.accepted, (size_t)r.count) ||
+            !read_all(c->reportFd, sched.startSlot, sizeof(short) * (size_t)r.count) ||
+            !read_all(c->reportFd, sched.dayShift, sizeof(short) * (size_t)r.count)) {
+            schedule_free(&sched);
+            break;
+        }
+        cache_store(cache, &sched, &r.stats, r.generation);
+    }
+    if (end && read_all(c->reportFd, child, sizeof(child))) {
+        for (k = 0; k < STAT_COUNT; k++) {
+            latency[k].count += child[k].count;
+            latency[k].totalUs += child[k].totalUs;
+            if (child[k].maxUs > latency[k].maxUs)
+                latency[k].maxUs = child[k].maxUs;
+            for (j = 0; j < LATENCY_BUCKETS; j++)
+                latency[k].buckets[j] += child[k].buckets[j];
+        }
+    }
+    close(c->reportFd);
+    waitpid(c->reportPid, NULL, 0);
+    c->reportPid = 0;
+    c->reportFd = -1;
+    reportWorkers--;
+}
+
+/* 伺服器模式下執行一行命令：執行期間把標準輸出指向客戶端的 socket，
+   printf 及報告子行程的輸出便直接送往客戶端，最後以 '\0' 標示回應結束。
+   endProgram 只結束該連線。回傳 0 = 連線應關閉，1 = 完成，
+   2 = 報告交由子行程執行中（其結束後才繼續該連線的下一行） */
+int serve_command(Client *c, char *line) {
+    int saved, open;
+    line += strspn(line, " \t");
+    if (strncmp(line, "printBookings", 13) == 0 && report_start(c, line))
+        return 2;
+    fflush(stdout);
+    saved = dup(STDOUT_FILENO);
+    if (saved < 0)
+        return 0;
+    if (dup2(c->fd, STDOUT_FILENO) < 0) {
+        close(saved);
+        return 0;
+    }
+    if (line[0] != '\0')
+        process_command(line);
+    open = !endRequested;
+    endRequested = 0;
+    fflush(stdout);
+    clearerr(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return write_all(c->fd, "", 1) && open;
+}
+
+/* 依序執行客戶端緩衝區中完整的命令行，回傳值同 serve_command；
+   報告交由子行程執行時暫停，其餘的行待報告完成後再執行，回應因此保持順序 */
+int client_run(Client *c) {
+    char *start = c->line, *newline;
+    int state = 1;
+    while (state == 1 && (newline = (char *)memchr(start, '\n', (size_t)(c->line + c->len - start))) != NULL) {
+        *newline = '\0';
+        if (newline > start && newline[-1] == '\r')
+            newline[-1] = '\0';
+        state = serve_command(c, start);
+        start = newline + 1;
+    }
+    c->len -= (int)(start - c->line);
+    memmove(c->line, start, (size_t)c->len);
+    if (state == 1 && c->len == (int)sizeof(c->line)) {
+        const char error[] = "Error: Command too long\n";
+        write_all(c->fd, error, sizeof(error));    /* 連同結尾的 '\0' */
+        return 0;
+    }
+    return state;
+}
+
+/* 讀取客戶端送來的資料並執行其中完整的命令行，回傳值同 serve_command */
+int client_read(Client *c) {
+    ssize_t n;
+    n = read(c->fd, c->line + c->len, sizeof(c->line) - (size_t)c->len);
+    if (n < 0 && errno == EINTR)
+        return 1;
+    if (n <= 0)
+        return 0;
+    c->len += (int)n;
+    return client_run(c);
+}
+
+static void server_signal(int sig) {
+    (void)sig;
+    serverStop = 1;
+}
+
+/* 依連線狀態更新 epoll 的監看對象：報告執行期間只監看其結果 pipe，
+   其後恢復監看連線；state 為 0 或無法監看時回傳 0，連線應關閉 */
+static int client_watch(int epollFd, Client *c, int state) {
+    struct epoll_event ev;
+    int fd = state == 2 ? c->reportFd : c->fd;
+    if (state != 0 && fd == c->watched)
+        return 1;
+    if (c->watched >= 0)
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, c->watched, NULL);
+    c->watched = -1;
+    if (state == 0)
+        return 0;
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        return 0;
+    c->watched = fd;
+    return 1;
+}
+
+/* 伺服器模式：於 Unix-domain socket path 接受多個客戶端，以 epoll 多工處理。
+   預約命令逐一在本行程執行，與互動模式共用同一份預約資料；
+   報告在子行程執行（見 report_start） */
+int run_server(const char *path) {
+    struct sockaddr_un addr;
+    struct epoll_event ev, events[SERVER_EVENTS];
+    struct sigaction sa;
+    struct timeval timeout;
+    Client *c;
+    int listenFd, epollFd, fd, n, i, state;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Error: Socket path too long\n");
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listenFd < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(path);
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, SOMAXCONN) < 0) {
+        perror(path);
+        close(listenFd);
+        return 1;
+    }
+    epollFd = epoll_create1(0);
+    if (epollFd < 0) {
+        perror("epoll_create1");
+        close(listenFd);
+        unlink(path);
+        return 1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;             /* NULL 代表監聽 socket */
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+
+    /* 客戶端中途離線不應終止伺服器；SIGINT / SIGTERM 不自動重啟 epoll_wait */
+    signal(SIGPIPE, SIG_IGN);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = server_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    timeout.tv_sec = SERVER_SEND_TIMEOUT;
+    timeout.tv_usec = 0;
+
+    printf("~ WELCOME TO PolyU ~ (serving on %s)\n", path);
+    fflush(stdout);
+    while (!serverStop) {
+        n = epoll_wait(epollFd, events, SERVER_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            c = (Client *)events[i].data.ptr;
+            if (c == NULL) {
+                while ((fd = accept(listenFd, NULL, NULL)) >= 0) {
+                    /* 回應以阻塞方式寫出，逾時未能送出的客戶端會被中斷 */
+                    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                    c = (Client *)calloc(1, sizeof(Client));
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = c;
+                    if (c == NULL || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                        free(c);
+                        close(fd);
+                        continue;
+                    }
+                    c->fd = fd;
+                    c->watched = fd;
+                }
             } else {
-                sprintf(outBuffer, "No rejected bookings.\n");
-                write(pipefd[1], outBuffer, strlen(outBuffer));
+                if (c->reportPid > 0) {     /* 報告子行程的 pipe：報告已完成 */
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, c->reportFd, NULL);
+                    c->watched = -1;
+                    report_finish(c);
+                    state = client_run(c);
+                } else {
+                    state = client_read(c);
+                }
+                if (!client_watch(epollFd, c, state)) {
+                    if (c->reportPid > 0)
+                        report_finish(c);
+                    close(c->fd);
+                    free(c);
+                }
             }
-            sprintf(outBuffer, "===========================================================================\n");
-            write(pipefd[1], outBuffer, strlen(outBuffer));
         }
-        
-        close(pipefd[1]);
-        wait(NULL);
-        printf("-> [Done!]\n");
     }
+    close(epollFd);
+    close(listenFd);
+    unlink(path);
+    printf("Bye!\n");
+    return 0;
 }
 
-/* Main 函式 */
-int main() {
+/* Main 函式；./SPMS [-server PATH] [-data DIR] [-report pipe|shm]，
+   -server 以伺服器模式執行，-data 將預約記錄保存在 DIR 並於啟動時還原，
+   -report shm 使報告內容經共享記憶體交給 reporter 行程 */
+int main(int argc, char *argv[]) {
     char input[MAX_LINE_LENGTH];
+    const char *server = NULL, *data = NULL;
+    int i, status, shm = 0;
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-server") == 0)
+            server = argv[i + 1];
+        else if (strcmp(argv[i], "-data") == 0)
+            data = argv[i + 1];
+        else if (strcmp(argv[i], "-report") == 0 && strcmp(argv[i + 1], "pipe") == 0)
+            shm = 0;
+        else if (strcmp(argv[i], "-report") == 0 && strcmp(argv[i + 1], "shm") == 0)
+            shm = 1;
+        else
+            break;
+    }
+    if (i != argc) {
+        printf("Usage: %s [-server PATH] [-data DIR] [-report pipe|shm]\n", argv[0]);
+        return 1;
+    }
+    reporter_start(shm);
+    if (data != NULL && !journal_open(data))
+        return 1;
+    if (server != NULL) {
+        status = run_server(server);
+        journal_close();
+        return status;
+    }
     printf("~ WELCOME TO PolyU ~\n");
     while (1) {
         printf("Please enter booking:\n");
@@ -1328,6 +3966,9 @@ int main() {
         if (strlen(input) == 0)
             continue;
         process_command(input);
+        if (endRequested)
+            break;
     }
+    journal_close();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,252 @@
+/* spms_bench.c
+   Benchmark driver for SPMS. For each workload size it generates a batch
+   file with spms_gen, starts ./SPMS in server mode and measures over the
+   socket:
+     - addBatch throughput,
+     - latency of single add commands (taken from the same workload),
+     - each print command, once right after a new booking (cold: runs the
+       scheduler and prints) and then repeated (warm: cached schedule, print
+       only); cold minus warm estimates the scheduler itself.
+   The cold runs are preceded by one bookEssentials for member_bench on
+   2099-12-31 so every scheduler cache is invalidated.
+   -report pipe,shm repeats every size once per report transport of SPMS
+   (socket to the reporter process, or the shared-memory ring) to compare them.
+   Build: gcc -O2 spms_bench.c -o spms_bench
+   Usage: ./spms_bench [-spms ./SPMS] [-gen ./spms_gen] [-sizes 1000,10000,100000,1000000]
+                       [-repeat R] [-batch OPTION] [-report pipe|shm|pipe,shm]
+                       [generator options, see spms_gen.c]
+   e.g. ./spms_bench -sizes 10000 -batch -bulk -contention 2
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+
+#define MAX_LINE_LENGTH 256
+#define MAX_SIZES 16
+#define MAX_TRANSPORTS 2
+#define MAX_GEN_ARGS 32
+#define ADD_COMMANDS 1000               /* single add commands timed per size */
+#define CONNECT_TRIES 500               /* 10 ms apart */
+
+const char *reportCommands[] = {
+    "printBookings -fcfs",
+    "printBookings -prio",
+    "printBookings -OPTI",
+    "printBookings -OPTI_EXACT",
+    "printBookings -ALL"
+};
+#define REPORT_COMMANDS (int)(sizeof(reportCommands) / sizeof(reportCommands[0]))
+
+long responseBytes;                     /* bytes of the last response */
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* 執行 argv 所指定的程式並等待結束，成功回傳 1 */
+int run_program(char *const argv[]) {
+    int status;
+    pid_t pid = fork();
+    if (pid < 0)
+        return 0;
+    if (pid == 0) {
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* 以伺服器模式及指定的報告傳送方式啟動 SPMS（輸出導向 /dev/null），並連線至其 socket */
+pid_t start_spms(const char *spms, const char *sockPath, const char *transport, int *fd) {
+    struct sockaddr_un addr;
+    pid_t pid;
+    int i, devnull;
+    unlink(sockPath);
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0) {
+        devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0)
+            dup2(devnull, STDOUT_FILENO);
+        execl(spms, spms, "-server", sockPath, "-report", transport, (char *)NULL);
+        perror(spms);
+        _exit(127);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sockPath, sizeof(addr.sun_path) - 1);
+    for (i = 0; i < CONNECT_TRIES; i++) {
+        *fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (*fd >= 0 && connect(*fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+            return pid;
+        close(*fd);
+        usleep(10000);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+/* 送出一個命令並讀取回應直到 '\0'，回傳往返時間（毫秒），失敗回傳 -1 */
+double request(int fd, const char *command) {
+    char buffer[65536];
+    char line[MAX_LINE_LENGTH + 1];
+    double start = now_ms();
+    size_t len;
+    ssize_t n;
+    sprintf(line, "%.*s\n", MAX_LINE_LENGTH - 1, command);
+    len = strlen(line);
+    responseBytes = 0;
+    if (write(fd, line, len) != (ssize_t)len)
+        return -1;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        responseBytes += n;
+        if (memchr(buffer, '\0', (size_t)n) != NULL)
+            return now_ms() - start;
+    }
+    return -1;
+}
+
+/* 讀取批次檔的前 max 行作為單筆新增命令 */
+int read_commands(const char *path, char commands[][MAX_LINE_LENGTH], int max) {
+    FILE *fp = fopen(path, "r");
+    int n = 0;
+    if (fp == NULL)
+        return 0;
+    while (n < max && fgets(commands[n], MAX_LINE_LENGTH, fp) != NULL) {
+        commands[n][strcspn(commands[n], "\r\n")] = '\0';
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+/* 對一種規模執行全部量測 */
+int bench_size(const char *spms, const char *transport, long size, const char *batchFile,
+               const char *batchOption, int repeat, char commands[][MAX_LINE_LENGTH], int commandCount) {
+    char sockPath[64], command[MAX_LINE_LENGTH];
+    double t, cold, warm[64], latency[ADD_COMMANDS], total;
+    pid_t pid;
+    int fd, i, r;
+
+    sprintf(sockPath, "/tmp/spms_bench.%d.sock", (int)getpid());
+    pid = start_spms(spms, sockPath, transport, &fd);
+    if (pid < 0) {
+        printf("Error: Cannot start %s\n", spms);
+        return 0;
+    }
+    printf("== %ld bookings, report %s ==\n", size, transport);
+
+    sprintf(command, "addBatch -%s%s%s", batchFile, batchOption[0] ? " " : "", batchOption);
+    t = request(fd, command);
+    printf("%-26s %10.1f ms  %10.0f bookings/s\n", "addBatch", t, t > 0 ? size / (t / 1e3) : 0.0);
+
+    total = 0;
+    for (i = 0; i < commandCount; i++) {
+        latency[i] = request(fd, commands[i]);
+        total += latency[i];
+    }
+    qsort(latency, (size_t)commandCount, sizeof(double), cmp_double);
+    if (commandCount > 0)
+        printf("%-26s p50 %.1f us  p99 %.1f us  max %.1f us  %.0f commands/s\n", "add (single command)",
+               latency[commandCount / 2] * 1e3, latency[commandCount * 99 / 100] * 1e3,
+               latency[commandCount - 1] * 1e3, commandCount / (total / 1e3));
+
+    for (i = 0; i < REPORT_COMMANDS; i++) {
+        request(fd, "bookEssentials -member_bench 2099-12-31 00:00 0.5 battery;");
+        cold = request(fd, reportCommands[i]);
+        for (r = 0; r < repeat; r++)
+            warm[r] = request(fd, reportCommands[i]);
+        qsort(warm, (size_t)repeat, sizeof(double), cmp_double);
+        printf("%-26s cold %.1f ms  warm %.1f ms  schedule %.1f ms  output %.2f MB\n",
+               reportCommands[i], cold, warm[repeat / 2], cold - warm[repeat / 2],
+               responseBytes / 1048576.0);
+    }
+
+    close(fd);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    static char commands[ADD_COMMANDS][MAX_LINE_LENGTH];
+    const char *spms = "./SPMS", *batchOption = "";
+    char *transports[MAX_TRANSPORTS] = { "pipe" };
+    char *genArgs[MAX_GEN_ARGS + 6];
+    char sizeText[32], batchFile[64], *p;
+    long sizes[MAX_SIZES] = { 1000, 10000, 100000, 1000000 };
+    int sizeCount = 4, repeat = 3, genCount = 1, transportCount = 1, i, s, t, ok = 1;
+
+    genArgs[0] = "./spms_gen";
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-spms") == 0)
+            spms = argv[i + 1];
+        else if (strcmp(argv[i], "-gen") == 0)
+            genArgs[0] = argv[i + 1];
+        else if (strcmp(argv[i], "-repeat") == 0)
+            repeat = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-batch") == 0)
+            batchOption = argv[i + 1];
+        else if (strcmp(argv[i], "-report") == 0) {
+            transportCount = 0;
+            for (p = strtok(argv[i + 1], ","); p != NULL && transportCount < MAX_TRANSPORTS; p = strtok(NULL, ","))
+                transports[transportCount++] = p;
+        }
+        else if (strcmp(argv[i], "-sizes") == 0) {
+            for (sizeCount = 0, p = argv[i + 1]; sizeCount < MAX_SIZES && *p != '\0'; sizeCount++) {
+                sizes[sizeCount] = strtol(p, &p, 10);
+                if (*p == ',')
+                    p++;
+            }
+        } else if (genCount + 2 <= MAX_GEN_ARGS) {
+            genArgs[genCount++] = argv[i];      /* 其餘選項交給 spms_gen */
+            genArgs[genCount++] = argv[i + 1];
+        } else
+            break;
+    }
+    if (i != argc || repeat < 1 || repeat > 64 || sizeCount == 0 || transportCount == 0) {
+        printf("Usage: %s [-spms PATH] [-gen PATH] [-sizes N,N,...] [-repeat 1-64]\n"
+               "       [-batch OPTION] [-report pipe|shm|pipe,shm] [spms_gen options]\n", argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    sprintf(batchFile, "/tmp/spms_bench.%d.dat", (int)getpid());
+
+    for (s = 0; ok && s < sizeCount; s++) {
+        sprintf(sizeText, "%ld", sizes[s]);
+        genArgs[genCount] = "-n";
+        genArgs[genCount + 1] = sizeText;
+        genArgs[genCount + 2] = "-o";
+        genArgs[genCount + 3] = batchFile;
+        genArgs[genCount + 4] = NULL;
+        if (!run_program(genArgs)) {
+            printf("Error: Cannot generate workload with %s\n", genArgs[0]);
+            ok = 0;
+            break;
+        }
+        for (t = 0; ok && t < transportCount; t++)
+            ok = bench_size(spms, transports[t], sizes[s], batchFile, batchOption, repeat,
+                            commands, read_commands(batchFile, commands, ADD_COMMANDS));
+    }
+    unlink(batchFile);
+    return ok ? 0 : 1;
+}
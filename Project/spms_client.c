@@ -0,0 +1,84 @@
+/* spms_client.c
+   Kiosk client for the SPMS server mode (./SPMS -server PATH).
+   Sends each command line read from stdin to the server and prints the
+   response, which the server terminates with a single '\0' byte.
+   Build: gcc -O2 spms_client.c -o spms_client
+   Usage: ./spms_client PATH [< commands.txt]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_LINE_LENGTH 256
+
+/* 連線至伺服器的 Unix-domain socket，失敗回傳 -1 */
+int connect_server(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* 將回應印出直到 '\0'；連線中斷回傳 0 */
+int print_response(int fd) {
+    char buffer[4096];
+    ssize_t n;
+    char *end;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        end = (char *)memchr(buffer, '\0', (size_t)n);
+        fwrite(buffer, 1, end != NULL ? (size_t)(end - buffer) : (size_t)n, stdout);
+        if (end != NULL) {
+            fflush(stdout);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    char input[MAX_LINE_LENGTH];
+    int fd, interactive;
+    size_t len;
+    if (argc != 2) {
+        printf("Usage: %s PATH\n", argv[0]);
+        return 1;
+    }
+    fd = connect_server(argv[1]);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    interactive = isatty(STDIN_FILENO);
+    while (1) {
+        if (interactive)
+            printf("Please enter booking:\n");
+        if (fgets(input, sizeof(input), stdin) == NULL)
+            break;
+        input[strcspn(input, "\n")] = '\0';
+        if (strlen(input) == 0)
+            continue;
+        len = strlen(input);
+        input[len++] = '\n';
+        if (write(fd, input, len) != (ssize_t)len || !print_response(fd))
+            break;
+        if (strncmp(input, "endProgram", 10) == 0)
+            break;
+    }
+    close(fd);
+    return 0;
+}
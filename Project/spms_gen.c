@@ -0,0 +1,144 @@
+/* spms_gen.c
+   Synthetic workload generator for SPMS: writes a batch file for addBatch.
+   Bookings are spread uniformly over the members and the date span; the
+   contention level narrows the hours they ask for (1 = 08:00-20:00, 4 = a
+   three-hour window), so higher levels mean more rejections and preemption.
+   The same seed always gives the same file.
+   Build: gcc -O2 spms_gen.c -o spms_gen
+   Usage: ./spms_gen [-n N] [-members M] [-days D] [-start YYYY-MM-DD]
+                     [-contention C] [-mix P,R,E,B] [-seed S] [-o FILE]
+   -mix gives the relative weights of addParking, addReservation, addEvent
+   and bookEssentials (default 40,30,10,20).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define COMMAND_TYPES 4
+#define DEVICE_PAIRS 3
+
+const char *commandNames[COMMAND_TYPES] = { "addParking", "addReservation", "addEvent", "bookEssentials" };
+
+/* 設備依規格成對提供：電池與充電線、儲物櫃與雨傘、代客泊車與充氣服務 */
+const char *devicePairs[DEVICE_PAIRS][2] = {
+    { "battery", "cable" },
+    { "locker", "umbrella" },
+    { "valetPark", "inflationService" }
+};
+
+unsigned long long rngState = 88172645463325252ULL;
+
+/* xorshift64*：結果不依賴系統的 rand()，不同平台產生相同檔案 */
+unsigned long long rng_next(void) {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ULL;
+}
+
+/* 0 到 n-1 之間的亂數 */
+int rng_below(int n) {
+    return (int)((rng_next() >> 33) % (unsigned long long)n);
+}
+
+/* 第 id 位會員的名稱：member_A ... member_Z, member_AA ... */
+void member_name(int id, char *buf) {
+    char letters[16];
+    int n = 0, i;
+    id++;
+    while (id > 0) {
+        id--;
+        letters[n++] = (char)('A' + id % 26);
+        id /= 26;
+    }
+    strcpy(buf, "member_");
+    for (i = 0; i < n; i++)
+        buf[7 + i] = letters[n - 1 - i];
+    buf[7 + n] = '\0';
+}
+
+/* 由起始日期加上 offset 日，寫成 YYYY-MM-DD */
+void format_day(const struct tm *start, int offset, char *buf) {
+    struct tm t = *start;
+    t.tm_mday += offset;
+    t.tm_hour = 12;
+    mktime(&t);
+    strftime(buf, 16, "%Y-%m-%d", &t);
+}
+
+int main(int argc, char *argv[]) {
+    long n = 1000, i;
+    int members = 5, days = 31, mix[COMMAND_TYPES] = { 40, 30, 10, 20 };
+    int totalWeight, type, slot, window, pair, k, w;
+    double contention = 1.0;
+    const char *output = NULL;
+    struct tm start;
+    char member[32], date[16];
+    FILE *fp;
+
+    memset(&start, 0, sizeof(start));
+    start.tm_year = 2025 - 1900;
+    start.tm_mon = 4;
+    start.tm_mday = 1;
+    for (k = 1; k + 1 < argc; k += 2) {
+        if (strcmp(argv[k], "-n") == 0)
+            n = atol(argv[k + 1]);
+        else if (strcmp(argv[k], "-members") == 0)
+            members = atoi(argv[k + 1]);
+        else if (strcmp(argv[k], "-days") == 0)
+            days = atoi(argv[k + 1]);
+        else if (strcmp(argv[k], "-start") == 0) {
+            if (sscanf(argv[k + 1], "%d-%d-%d", &start.tm_year, &start.tm_mon, &start.tm_mday) != 3)
+                break;
+            start.tm_year -= 1900;
+            start.tm_mon -= 1;
+        } else if (strcmp(argv[k], "-contention") == 0)
+            contention = atof(argv[k + 1]);
+        else if (strcmp(argv[k], "-mix") == 0) {
+            if (sscanf(argv[k + 1], "%d,%d,%d,%d", &mix[0], &mix[1], &mix[2], &mix[3]) != 4)
+                break;
+        } else if (strcmp(argv[k], "-seed") == 0)
+            rngState ^= strtoull(argv[k + 1], NULL, 10) * 0x9E3779B97F4A7C15ULL;
+        else if (strcmp(argv[k], "-o") == 0)
+            output = argv[k + 1];
+        else
+            break;
+    }
+    totalWeight = mix[0] + mix[1] + mix[2] + mix[3];
+    if (k != argc || n < 0 || members < 1 || days < 1 || contention < 1.0 ||
+        mix[0] < 0 || mix[1] < 0 || mix[2] < 0 || mix[3] < 0 || totalWeight <= 0) {
+        printf("Usage: %s [-n N] [-members M] [-days D] [-start YYYY-MM-DD]\n"
+               "       [-contention C>=1] [-mix P,R,E,B] [-seed S] [-o FILE]\n", argv[0]);
+        return 1;
+    }
+    fp = output != NULL ? fopen(output, "w") : stdout;
+    if (fp == NULL) {
+        perror(output);
+        return 1;
+    }
+
+    /* 可要求的開始時間：08:00 起 window 個 15 分鐘時段 */
+    window = (int)(48 / contention);
+    if (window < 4)
+        window = 4;
+    for (i = 0; i < n; i++) {
+        for (w = rng_below(totalWeight), type = 0; w >= mix[type]; type++)
+            w -= mix[type];
+        member_name(rng_below(members), member);
+        format_day(&start, rng_below(days), date);
+        slot = 32 + rng_below(window);
+        fprintf(fp, "%s -%s %s %02d:%02d %d.%d", commandNames[type], member, date,
+                slot / 4, slot % 4 * 15, 1 + rng_below(4), rng_below(2) * 5);
+        pair = rng_below(DEVICE_PAIRS);
+        if (type == 3)
+            fprintf(fp, " %s", devicePairs[pair][rng_below(2)]);
+        else if (type != 0 || rng_below(2))
+            fprintf(fp, " %s %s", devicePairs[pair][0], devicePairs[pair][1]);
+        fprintf(fp, ";\n");
+    }
+    if (fp != stdout)
+        fclose(fp);
+    return 0;
+}
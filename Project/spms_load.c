@@ -0,0 +1,208 @@
+/* spms_load.c
+   Load generator for the SPMS server mode (./SPMS -server PATH).
+   Opens C connections, each sending N requests one at a time and waiting
+   for the '\0'-terminated response, then reports requests per second and
+   the latency distribution over all requests.
+   Commands are taken in turn from FILE (one per line), or generated as
+   addParking requests spread over members A-E, May 2025 and 08:00-19:00.
+   Build: gcc -O2 -pthread spms_load.c -o spms_load
+   Usage: ./spms_load PATH [-c C] [-n N] [-f FILE]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_LINE_LENGTH 256
+#define MAX_CONNECTIONS 256
+
+/* 一個連線的工作內容及量測結果 */
+typedef struct {
+    pthread_t thread;
+    int id;
+    int requests;
+    int failed;
+    double *latency;                /* 每個請求的往返時間（微秒） */
+} LoadClient;
+
+const char *socketPath;
+char **commands = NULL;             /* -f 指定的命令，NULL 代表自動產生 */
+int commandCount = 0;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* 連線至伺服器的 Unix-domain socket，失敗回傳 -1 */
+int connect_server(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* 讀取並丟棄回應直到 '\0'；連線中斷回傳 0 */
+int skip_response(int fd) {
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        if (memchr(buffer, '\0', (size_t)n) != NULL)
+            return 1;
+    }
+    return 0;
+}
+
+/* 第 i 個請求的命令行（含結尾換行） */
+void make_command(LoadClient *lc, int i, char *line) {
+    unsigned int r;
+    if (commands != NULL) {
+        sprintf(line, "%s\n", commands[(lc->id + i) % commandCount]);
+        return;
+    }
+    r = (unsigned int)(lc->id * 7919 + i) * 2654435761u;
+    sprintf(line, "addParking -member_%c 2025-05-%02u %02u:00 %u.0;\n",
+            'A' + (int)(r % 5), 1 + (r >> 8) % 31, 8 + (r >> 16) % 11, 1 + (r >> 24) % 3);
+}
+
+void *client_main(void *arg) {
+    LoadClient *lc = (LoadClient *)arg;
+    char line[MAX_LINE_LENGTH + 1];
+    double start;
+    size_t len;
+    int i, fd;
+    fd = connect_server(socketPath);
+    if (fd < 0) {
+        lc->failed = lc->requests;
+        return NULL;
+    }
+    for (i = 0; i < lc->requests; i++) {
+        make_command(lc, i, line);
+        len = strlen(line);
+        start = now_us();
+        if (write(fd, line, len) != (ssize_t)len || !skip_response(fd)) {
+            lc->failed = lc->requests - i;
+            break;
+        }
+        lc->latency[i] = now_us() - start;
+    }
+    close(fd);
+    return NULL;
+}
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* 讀取命令檔，每行一個命令，空行略過 */
+int load_commands(const char *path) {
+    char line[MAX_LINE_LENGTH];
+    FILE *fp = fopen(path, "r");
+    int capacity = 0;
+    if (fp == NULL)
+        return 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || strncmp(line, "endProgram", 10) == 0)
+            continue;
+        if (commandCount == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            commands = (char **)realloc(commands, sizeof(char *) * (size_t)capacity);
+            if (commands == NULL) {
+                fclose(fp);
+                return 0;
+            }
+        }
+        commands[commandCount] = (char *)malloc(strlen(line) + 1);
+        if (commands[commandCount] == NULL) {
+            fclose(fp);
+            return 0;
+        }
+        strcpy(commands[commandCount++], line);
+    }
+    fclose(fp);
+    return commandCount > 0;
+}
+
+int main(int argc, char *argv[]) {
+    LoadClient clients[MAX_CONNECTIONS];
+    int connections = 8, requests = 1000;
+    int i, j, total = 0, failed = 0;
+    double *all, start, elapsed;
+
+    if (argc < 2) {
+        printf("Usage: %s PATH [-c C] [-n N] [-f FILE]\n", argv[0]);
+        return 1;
+    }
+    socketPath = argv[1];
+    for (i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-c") == 0)
+            connections = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-n") == 0)
+            requests = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0) {
+            if (!load_commands(argv[i + 1])) {
+                printf("Error: Cannot read commands from %s\n", argv[i + 1]);
+                return 1;
+            }
+        } else
+            break;
+    }
+    if (i != argc || connections < 1 || connections > MAX_CONNECTIONS || requests < 1) {
+        printf("Error: Usage: %s PATH [-c 1-%d] [-n N] [-f FILE]\n", argv[0], MAX_CONNECTIONS);
+        return 1;
+    }
+
+    all = (double *)malloc(sizeof(double) * (size_t)connections * (size_t)requests);
+    if (all == NULL) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+    start = now_us();
+    for (i = 0; i < connections; i++) {
+        clients[i].id = i;
+        clients[i].requests = requests;
+        clients[i].failed = 0;
+        clients[i].latency = all + (size_t)i * (size_t)requests;
+        pthread_create(&clients[i].thread, NULL, client_main, &clients[i]);
+    }
+    for (i = 0; i < connections; i++)
+        pthread_join(clients[i].thread, NULL);
+    elapsed = now_us() - start;
+
+    /* 把成功的請求集中到 all 的前段再排序 */
+    for (i = 0; i < connections; i++) {
+        for (j = 0; j < requests - clients[i].failed; j++)
+            all[total++] = clients[i].latency[j];
+        failed += clients[i].failed;
+    }
+    qsort(all, (size_t)total, sizeof(double), cmp_double);
+
+    printf("Connections: %d, requests: %d (%d failed)\n", connections, total, failed);
+    if (total > 0) {
+        printf("Throughput: %.0f requests/s over %.3f s\n", total / (elapsed / 1e6), elapsed / 1e6);
+        printf("Latency (us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+               all[(size_t)(total * 0.50)], all[(size_t)(total * 0.90)],
+               all[(size_t)(total * 0.99)], all[(size_t)(total * 0.999)], all[total - 1]);
+    }
+    free(all);
+    return failed > 0;
+}